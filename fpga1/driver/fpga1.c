@@ -36,110 +36,116 @@
 #define GAMECP_PCI_DEVICE_ID            0x407b
 /* The number of the PCI BAR that maps the interrupt controller. */
 #define GAMECP_INTERRUPT_CONTROLLER_BAR 4
+/* The memory BARs (buffered SRAM, SOC1 RAM and internal SRAM) may be */
+/* mapped write-combining, whether or not the FPGA declares them as  */
+/* prefetchable. */
+#define GAMECP_WRITE_COMBINING_BARS     (1 << 0 | 1 << 2 | 1 << 3)
 /* The type of the interrupt controller's registers. */
 /* Let's hope we never hit unsane hardware that has  */
 /* sizes that differ from one to the next interrupt  */
 /* control register.                                 */
 typedef unsigned int gamecp_reg_t;
+/* The interrupt control registers that the driver keeps a shadow     */
+/* copy of, so that they can be changed without a read-modify-write   */
+/* cycle on the PCI bus. Each entry is the offset of the control      */
+/* register belonging to the first interrupt source register.         */
+#define FPGA1_REGS_INT0_MASK            0x0020  /* INT_MASK1 */
+#define FPGA1_REGS_INT0_TRIGGER_01      0x0030  /* INT_TRIGGER_MODE11 (rise) */
+#define FPGA1_REGS_INT0_TRIGGER_10      0x0040  /* INT_TRIGGER_MODE12 (fall) */
+enum fpga1_control {FPGA1_MASK, FPGA1_TRIGGER_01, FPGA1_TRIGGER_10};
+#define GAMECP_CONTROL_REGISTERS {\
+	[FPGA1_MASK]       = FPGA1_REGS_INT0_MASK,\
+	[FPGA1_TRIGGER_01] = FPGA1_REGS_INT0_TRIGGER_01,\
+	[FPGA1_TRIGGER_10] = FPGA1_REGS_INT0_TRIGGER_10,\
+}
+/* An event is identfied by its register index and its bit position,  */
+/* both sharing one integer. This is how many of the (lower) bits of   */
+/* that integer are reserved for the bit position. Being a constant,   */
+/* gamecp.h derives all of its mapping tables from it at compile time. */
+#define GAMECP_SPLIT                    8
 /* We need the mapping of event identifiers to the  */
 /* combined address / bit position number defined   */
 /* in GAMECP_INTERRUPTS to create the mapping array */
 /* in gamecp.h.                                     */
 #include "fpga1.h"
 
-/* An event is identfied by its register index and its bit position,  */
-/* both sharing one integer. The number returned by this function is  */
-/* how many of the (lower) bits of that integer are reserved for the  */
-/* bit position. */
-static int gamecp_split(void) {return 8;}
-
 /* This function knows how to acknowledge an interrupt for a specific */
 /* event identifier / reason combination.                             */
 #define FPGA1_REGS_INT0_SRC             0x0000  /* INT_SOURCE1 */
 static void gamecp_ack(struct gamecp_device *gamecp, eventid_t event_reason)
 {
-	/* Calculate the value being mapped to the event identifier.   */
-	int indexAndBit = GAMECP_INTERRUPTS[event_reason / gamecp->reason_num];
-	/* Get the register index part of that value.                  */
-	/* Note that we shamelessly defined the register index in the  */
-	/* event identifier table so that we find the interrupt source */
-	/* register offsets by a simple addition of the register index */
-	/* to the first interrupt source register.                     */
-	int offset = gamecp_registerid(indexAndBit) + FPGA1_REGS_INT0_SRC;
+	/* Look up the register index and bit mask being mapped to     */
+	/* the event identifier.                                       */
+	const struct gamecp_source *source = &gamecp_sources[event_reason / GAMECP_REASON_NUM];
 	/* Check if the event is within the allowed range.             */
-	BUG_ON(event_reason >= ARRAY_NUMBER(GAMECP_INTERRUPTS) * gamecp->reason_num);
+	BUG_ON(event_reason >= ARRAY_NUMBER(GAMECP_INTERRUPTS) * GAMECP_REASON_NUM);
 	/* For our interrupt controller, the interrupt is acknowledged */
 	/* by writing a 1 to its source register's bit position.       */
-	iowrite32(gamecp_bitposition(indexAndBit), gamecp->regs + offset);
+	iowrite32(source->bit, gamecp->regs + source->reg * sizeof(gamecp_reg_t) + FPGA1_REGS_INT0_SRC);
+}
+/* This optional function knows how to acknowledge all interrupts of */
+/* one interrupt source register at once.                             */
+void gamecp_ack_register(struct gamecp_device *gamecp, int reg, gamecp_reg_t bits)
+{
+	/* As the source registers are write-1-to-clear, a single      */
+	/* posted write acknowledges all bits being handled in one     */
+	/* dispatch pass instead of one write per bit.                 */
+	iowrite32(bits, gamecp->regs + reg * sizeof(gamecp_reg_t) + FPGA1_REGS_INT0_SRC);
 }
 
-/* This function knows how to read a snapshot of all the device's      */
-/* interrupt source registers and returns true as long as at least one */
-/* interrupt source is active. This yields much better performance     */
-/* when testing single bits (see next function) compared to doing a    */
-/* new register read for every test.                                   */
-static bool gamecp_store(struct gamecp_device *gamecp)
+/* This function knows how to read a snapshot of the device's          */
+/* interrupt source registers being set in the regs bitmap (i.e. the   */
+/* ones having enabled sources and being routed to the interrupt       */
+/* vector at hand) into src_regs and returns true as long as           */
+/* at least one interrupt source is active. The generic part of the    */
+/* driver then only visits the bits being set in that snapshot, which  */
+/* yields much better performance compared to doing a new register     */
+/* read or a table scan for every event.                               */
+static bool gamecp_store(struct gamecp_device *gamecp, unsigned long regs, gamecp_reg_t *src_regs)
 {
 	/* The generic part of the driver magically took care to       */
-	/* allocate sufficient space for all interrupt source          */
-	/* registers ...                                               */
-	gamecp_reg_t *regs = (gamecp_reg_t *) gamecp->src_regs;
+	/* reserve sufficient space for all interrupt source registers */
+	/* in src_regs ...                                             */
 	int i;
 	bool ret = false;
-	/* ... as it knows how many source registers are there.        */
-        /* So we iterate over all these registers ...                  */
-	for(i = 0; i < gamecp->reg_num; i++) {
+	/* ... as it knows how many source registers are there and     */
+	/* which of them need to be read at all. So we iterate over    */
+	/* just these registers ...                                    */
+	for_each_set_bit(i, &regs, GAMECP_REG_NUM) {
 		/* ... reading one after the other ...                 */
-		regs[i] = ioread32(gamecp->regs + i * sizeof(gamecp_reg_t) + FPGA1_REGS_INT0_SRC);
+		src_regs[i] = ioread32(gamecp->regs + i * sizeof(gamecp_reg_t) + FPGA1_REGS_INT0_SRC);
 		/* ... and cumulating their values in the function's   */
 		/* return value.                                       */
-		ret |= regs[i];
+		ret |= src_regs[i];
 	}
 	return ret;
 }
-/* This function knows how to test whether a interrupt source bit for  */
-/* a specific event identifier / reason combination is set by          */
-/* evaluating the previously stored snapshot.                          */
-static bool gamecp_test(struct gamecp_device *gamecp, eventid_t event_reason)
-{
-	/* Assuming a snapshot of the interrupt source registers has   */
-	/* already been stored.                                        */
-	gamecp_reg_t *regs = (gamecp_reg_t *) gamecp->src_regs;
-	/* Calculate the value being mapped to the event identifier.   */
-	int indexAndBit = GAMECP_INTERRUPTS[event_reason / gamecp->reason_num];
-	/* Check if the event is within the allowed range.             */
-	BUG_ON(event_reason >= ARRAY_NUMBER(GAMECP_INTERRUPTS) * gamecp->reason_num);
-	/* A 1 in the related address / bit position indicates an      */
-	/* an active interrupt request.                                */ 
-	return regs[gamecp_registerid(indexAndBit) / sizeof(gamecp_reg_t)] & gamecp_bitposition(indexAndBit);
-}
 
 #define SET |
 #define RESET & ~
-#define SET_BIT(operation, type) {\
-	int offset = gamecp_registerid(indexAndBit) + type;\
-	gamecp_reg_t tmp = ioread32(gamecp->regs + offset) operation gamecp_bitposition(indexAndBit);\
-	iowrite32(tmp, gamecp->regs + offset);\
+/* The new register value is derived from the driver's shadow copy, */
+/* so no PCI read is needed. */
+#define SET_BIT(operation, control) {\
+	gamecp_reg_t tmp = *gamecp_control(gamecp, control, source->reg) operation source->bit;\
+	gamecp_control_write(gamecp, control, source->reg, tmp);\
 }
-#define FPGA1_REGS_INT0_MASK            0x0020  /* INT_MASK1 */
-#define FPGA1_REGS_INT0_TRIGGER_01      0x0030  /* INT_TRIGGER_MODE11 (rise) */
-#define FPGA1_REGS_INT0_TRIGGER_10      0x0040  /* INT_TRIGGER_MODE12 (fall) */
 #define SET_BITS(trigger01, trigger10, mask)\
-	SET_BIT(trigger01, FPGA1_REGS_INT0_TRIGGER_01);\
-	SET_BIT(trigger10, FPGA1_REGS_INT0_TRIGGER_10);\
-	SET_BIT(mask, FPGA1_REGS_INT0_MASK);\
+	SET_BIT(trigger01, FPGA1_TRIGGER_01);\
+	SET_BIT(trigger10, FPGA1_TRIGGER_10);\
+	SET_BIT(mask, FPGA1_MASK);\
 	break
 /* This function knows how to set up an interrupt to fire on the       */
 /* reason being encoded in a specific event identifier / reason        */
 /* combination.                                                        */
 static void gamecp_trigger(struct gamecp_device *gamecp, eventid_t event_reason)
 {
-	/* Calculate the value being mapped to the event identifier.   */
-	int indexAndBit = GAMECP_INTERRUPTS[event_reason / gamecp->reason_num];
+	/* Look up the register index and bit mask being mapped to     */
+	/* the event identifier.                                       */
+	const struct gamecp_source *source = &gamecp_sources[event_reason / GAMECP_REASON_NUM];
 	/* Calculate the reason. */
-	int reason = event_reason % gamecp->reason_num;
+	int reason = event_reason % GAMECP_REASON_NUM;
 	/* Check if the event is within the allowed range.             */
-	BUG_ON(event_reason >= ARRAY_NUMBER(GAMECP_INTERRUPTS) * gamecp->reason_num);
+	BUG_ON(event_reason >= ARRAY_NUMBER(GAMECP_INTERRUPTS) * GAMECP_REASON_NUM);
 	switch(reason) {
 		case GAMECP_INTERRUPTS_RISING: SET_BITS(SET, RESET, SET);
 		case GAMECP_INTERRUPTS_FALLING: SET_BITS(SET, RESET, SET);
@@ -151,6 +157,18 @@ static void gamecp_trigger(struct gamecp_device *gamecp, eventid_t event_reason)
 	/* state. */
 	gamecp_ack(gamecp, event_reason);
 }
+/* This optional function knows how to mask or unmask the interrupt of */
+/* an event identifier / reason combination, leaving its trigger mode  */
+/* alone. The source register still latches the configured edges      */
+/* while the interrupt is masked, so the source may be busy polled.    */
+void gamecp_mask(struct gamecp_device *gamecp, eventid_t event_reason, bool mask)
+{
+	/* Look up the register index and bit mask being mapped to     */
+	/* the event identifier.                                       */
+	const struct gamecp_source *source = &gamecp_sources[event_reason / GAMECP_REASON_NUM];
+	if(mask) SET_BIT(RESET, FPGA1_MASK)
+	else SET_BIT(SET, FPGA1_MASK)
+}
 
 /* This function does additional initialization at the end of          */
 /* module_init                                                         */
@@ -85,8 +85,8 @@
 /* table: The lower part of the numbers being found there are the bit     */
 /* positions of the related interrupts, while the upper part serves as    */
 /* an index that allows to calculate the related register addresses. The  */
-/* exact split is defined by the value returned by the gamecp_split()     */
-/* function in fpga1.c, see there for a more detailed description.        */
+/* exact split is defined by GAMECP_SPLIT in fpga1.c, see there for a    */
+/* more detailed description.                                             */
 /**************************************************************************/
 #define GAMECP_INTERRUPTS(x)\
     /* Bits for INT0. */\
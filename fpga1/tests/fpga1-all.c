@@ -0,0 +1,44 @@
+/*
+ * CPU555 FPGA1 driver test application
+ * Single mapping of all BARs and the status page
+ *
+ * Copyright (C) Siemens AG, 2026
+ * All Rights Reserved
+ */
+
+/* Maps all BARs and the status page with a single mmap() call, */
+/* prints where each of them ended up and reads the FPGA version */
+/* through the mapping.                                          */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include "fpga1.h"
+
+int main(int argc, char *argv[])
+{
+	struct gamecp_layout layout;
+	uint8_t *all;
+	int fd, i;
+
+	fd = open("/dev/fpga1-0", O_RDWR);
+	assert(fd >= 0);
+	assert(ioctl(fd, GAMECP_GET_LAYOUT, &layout) == 0);
+	all = mmap(NULL, layout.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, GAMECP_ALL);
+	assert(all != MAP_FAILED);
+
+	for(i = 0; i < ARRAY_NUMBER(layout.bar); i++) {
+		if(layout.bar[i] != GAMECP_ABSENT) printf("BAR %d at %08x\n", i, layout.bar[i]);
+	}
+	assert(layout.bar[FPGA1_OFFSET_REGISTERS / GAMECP_BAR_WINDOW_SIZE] != GAMECP_ABSENT);
+	printf("fpga1 version %08x\n", *(volatile uint32_t *)
+	       (all + layout.bar[FPGA1_OFFSET_REGISTERS / GAMECP_BAR_WINDOW_SIZE] + FPGA1_REGS_FPGA_VERS));
+	if(layout.status != GAMECP_ABSENT) {
+		const struct gamecp_status *status = (const struct gamecp_status *) (all + layout.status);
+		printf("status page at %08x, %u sources\n", layout.status, status->sources);
+	}
+	return 0;
+}
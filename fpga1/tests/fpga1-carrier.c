@@ -49,7 +49,7 @@ int main(int argc, char *argv[]) {
 	struct sigevent event;
 	int fd, i;
 
-	fd = open("/dev/fpga1", O_RDWR);
+	fd = open("/dev/fpga1-0", O_RDWR);
 	assert(fd >= 0);
 	regs = mmap(NULL, FPGA1_REGISTERS_SIZE, PROT_READ | PROT_WRITE,
 		    MAP_SHARED, fd, FPGA1_OFFSET_REGISTERS);
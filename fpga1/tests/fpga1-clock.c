@@ -60,7 +60,7 @@ int main(int argc, char *argv[])
 	sigset_t set;
 	int err, fd, i;
 
-	fd = open("/dev/fpga1", O_RDWR);
+	fd = open("/dev/fpga1-0", O_RDWR);
 	assert(fd >= 0);
 	regs = mmap(NULL, FPGA1_REGISTERS_SIZE, PROT_READ | PROT_WRITE,
 		    MAP_SHARED, fd, FPGA1_OFFSET_REGISTERS);
@@ -122,7 +122,9 @@ int main(int argc, char *argv[])
 	/* Event 1 setup: We can even set up an event for an */
 	/* interrupt that belongs to an existing clock. */
 	/* Note however that the event reason for a shared */
-	/* event and clock should match, otherwise the last one wins. */
+	/* event and clock must match, otherwise the later one is */
+	/* refused with EBUSY. Up to GAMECP_SUBSCRIBERS events and */
+	/* clocks may share an interrupt. */
 	memset(&irq_event1, 0, sizeof(irq_event1));
 	err = sigevent_set_notification(&irq_event1, 0, SIGRT0, pthread_self());
 	irq_event1.sigev_value.sival_ptr = gamecp_name(FPGA1_INT0_T7_INT_RISING);
@@ -133,8 +135,8 @@ int main(int argc, char *argv[])
 	write_reg32(regs, FPGA1_REGS_TIMER7_CMP, read_reg32(regs, FPGA1_REGS_TIMER7) + 5000000UL);
 
 	/* Event 2 setup: We cannot set up neither events nor clocks */
-	/* that only differs by its reason (here: RISING instead of */
-        /* FALLING. Good. */
+	/* that only differs by its reason (here: FALLING instead of */
+	/* RISING). Good. */
 	memset(&irq_event2, 0, sizeof(irq_event2));
 	err = sigevent_set_notification(&irq_event2, 0, SIGRT1, pthread_self());
 	irq_event2.sigev_value.sival_ptr = " irq from event 2";
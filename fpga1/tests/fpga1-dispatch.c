@@ -0,0 +1,138 @@
+/*
+ * CPU555 FPGA1 driver test application
+ * Interrupt dispatch benchmark
+ *
+ * Copyright (C) Siemens AG, 2026
+ * All Rights Reserved
+ */
+
+/* Compares the cycles being spent by a model of the table scanning     */
+/* dispatch loop that gamecp_irq_handler() used to run on every pass     */
+/* with a model of the bit scan dispatch loop it runs now, for 1, 4 and  */
+/* 48 simultaneously pending interrupt sources. Neither the device nor   */
+/* the driver is needed, as both loops work on a snapshot of the         */
+/* interrupt source registers.                                           */
+/* Note that this measures the models, not the driver: the loops below  */
+/* are written after gamecp.h, whose kernel part cannot be built in user */
+/* space, and only keep the scanning of the snapshot. Acknowledging,     */
+/* busy polling, storm checks and the delivery itself are left out, and  */
+/* the models are not updated along with gamecp.h. Use the              */
+/* gamecp_irq_entry / gamecp_irq_exit tracepoints or GAMECP_LATENCY to   */
+/* measure the driver itself.                                            */
+/* The models show the bit scan to be faster with few pending sources,   */
+/* but slower than the table scan with all 48 of them pending, as each   */
+/* set bit costs a bit search and a table lookup. This is accepted, few  */
+/* pending sources being the common case.                                */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#define GAMECP_KEEP_INTERRUPTS
+#include "fpga1.h"
+
+/* Must match GAMECP_SPLIT in fpga1.c. */
+#define SPLIT     8
+#define REG_NUM   4
+#define REG_BITS  32
+#define RUNS      100000
+
+#define VALUE_ITEM(name, value) value,
+static const int interrupts[] = {GAMECP_INTERRUPTS(VALUE_ITEM)};
+static short bit_event[REG_NUM * REG_BITS];
+static uint32_t src_regs[REG_NUM];
+/* The former driver divided by a runtime value as well. */
+static volatile size_t reason_num = FPGA1_INT0_T7_INT_NONE - FPGA1_INT0_T7_INT_RISING + 1;
+static volatile unsigned int delivered;
+
+static inline uint64_t rdtsc(void)
+{
+	uint32_t lo, hi;
+	__asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+	return ((uint64_t) hi << 32) | lo;
+}
+static inline int bitposition(int indexAndBit)
+{
+	return 1UL << (indexAndBit & ((1 << SPLIT) - 1));
+}
+static inline int registerid(int indexAndBit)
+{
+	return indexAndBit >> SPLIT;
+}
+
+/* Stands in for clock callback, event delivery and acknowledge. */
+static void __attribute__((noinline)) deliver(int i)
+{
+	delivered += i;
+}
+
+/* Model of the former dispatch loop: gamecp_test() for every table */
+/* entry. */
+static void __attribute__((noinline)) dispatch_scan(void)
+{
+	int i;
+	for(i = 0; i < ARRAY_NUMBER(interrupts); i++) {
+		int event_reason = i * reason_num;
+		int indexAndBit = interrupts[event_reason / reason_num];
+		if(src_regs[registerid(indexAndBit) / sizeof(uint32_t)] & bitposition(indexAndBit)) deliver(i);
+	}
+}
+
+/* Model of the current dispatch loop: only the bits being set are */
+/* visited. */
+static void __attribute__((noinline)) dispatch_bits(void)
+{
+	int r;
+	for(r = 0; r < REG_NUM; r++) {
+		const short *events = bit_event + r * REG_BITS;
+		unsigned long pending = src_regs[r];
+		while(pending) {
+			int bit = sizeof(long) * 8 - 1 - __builtin_clzl(pending);
+			pending &= ~(1UL << bit);
+			if(events[bit] >= 0) deliver(events[bit]);
+		}
+	}
+}
+
+static uint64_t measure(void (*dispatch)(void))
+{
+	uint64_t best = ~0ULL;
+	int i;
+	for(i = 0; i < RUNS; i++) {
+		uint64_t start = rdtsc();
+		dispatch();
+		start = rdtsc() - start;
+		if(start < best) best = start;
+	}
+	return best;
+}
+
+static void pend(int i)
+{
+	src_regs[registerid(interrupts[i]) / sizeof(uint32_t)] |= bitposition(interrupts[i]);
+}
+
+int main(int argc, char *argv[])
+{
+	/* The sources pending in the 4 bits case: a busy cycle. */
+	const int some[] = {
+		FPGA1_INT0_TIMER0_IRQ_RISING, FPGA1_INT0_T7_INT_RISING,
+		FPGA1_INT0_PNIO_IRT_RISING, FPGA1_INT4_T0_WATCHDOG_RISING
+	};
+	const int counts[] = {1, ARRAY_NUMBER(some), ARRAY_NUMBER(interrupts)};
+	int i, j;
+
+	memset(bit_event, -1, sizeof(bit_event));
+	for(i = 0; i < ARRAY_NUMBER(interrupts); i++) {
+		int reg = registerid(interrupts[i]) / sizeof(uint32_t);
+		bit_event[reg * REG_BITS + __builtin_ctz(bitposition(interrupts[i]))] = i;
+	}
+
+	for(j = 0; j < ARRAY_NUMBER(counts); j++) {
+		memset(src_regs, 0, sizeof(src_regs));
+		for(i = 0; i < counts[j]; i++) pend(counts[j] <= ARRAY_NUMBER(some) ? some[i] / reason_num : i);
+		printf("%2d pending: table scan %5llu cycles, bit scan %5llu cycles\n", counts[j],
+		       (unsigned long long) measure(dispatch_scan),
+		       (unsigned long long) measure(dispatch_bits));
+	}
+	return 0;
+}
@@ -0,0 +1,188 @@
+/*
+ * CPU555 FPGA1 driver test application
+ * Per-source state layout benchmark
+ *
+ * Copyright (C) Siemens AG, 2026
+ * All Rights Reserved
+ */
+
+/* Compares the cycles being spent by gamecp_dispatch() on the per-source */
+/* state with cold caches, as after a long idle period of the device,    */
+/* for one array per member and for the array of cache line aligned      */
+/* structs that struct gamecp_device has, for 1, 4 and 48 simultaneously  */
+/* pending interrupt sources. Both hold the members of struct            */
+/* gamecp_source_state, built without GAMECP_LATENCY, for a 64-bit       */
+/* kernel. It also prints how many cache lines the state of a single      */
+/* source is spread over. The structs win as long as few sources are     */
+/* pending, which is the common case, while the dense arrays touch fewer */
+/* lines and are faster once all sources are, the structs also carrying  */
+/* the members that only the configuration paths use. Neither the device */
+/* nor the driver is needed. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "fpga1.h"
+
+#define SOURCES     48
+#define SUBSCRIBERS 4
+#define LINE        64
+#define RUNS        10000
+
+struct storm {
+	unsigned long window;
+	unsigned int count;
+	_Bool masked;
+	unsigned long unmask;
+	unsigned long backoff;
+	unsigned int storms;
+};
+struct busy {
+	unsigned long idle;
+	unsigned long last;
+	_Bool active;
+};
+struct list {
+	struct list *next, *prev;
+};
+/* One array per member. */
+static struct {
+	void (*clock_callback[SOURCES][SUBSCRIBERS])(void);
+	unsigned long rings[SOURCES];
+	unsigned int waiters[SOURCES];
+	unsigned int events[SOURCES];
+	struct storm storm[SOURCES];
+	int nonrt_count[SOURCES];
+	int eventfd_count[SOURCES];
+	int trigger[SOURCES];
+} arrays __attribute__((aligned(LINE)));
+/* The layout of struct gamecp_source_state, including the members */
+/* not being used by the interrupt handler. */
+static struct source_state {
+	void (*clock_callback[SUBSCRIBERS])(void);
+	unsigned long rings;
+	unsigned int waiters;
+	unsigned int events;
+	struct storm storm;
+	int nonrt_count;
+	int eventfd_count;
+	int trigger;
+	int nonrt_coalesced;
+	unsigned int clocks;
+	int clock_id[SUBSCRIBERS];
+	unsigned int ev_slots;
+	unsigned int ev_claimed;
+	struct busy busy;
+	struct list eventfds;
+} __attribute__((aligned(LINE))) structs[SOURCES];
+static int pending[SOURCES];
+static volatile unsigned int delivered;
+
+/* Fenced, so that the misses are not hidden by out-of-order execution. */
+static inline uint64_t rdtsc(void)
+{
+	uint32_t lo, hi;
+	__asm__ __volatile__("mfence; lfence; rdtsc; lfence" : "=a"(lo), "=d"(hi) :: "memory");
+	return ((uint64_t) hi << 32) | lo;
+}
+static void clock_callback(void)
+{
+	delivered++;
+}
+
+/* The members being used on every occurrence, as in gamecp_dispatch(). */
+static void __attribute__((noinline)) dispatch_arrays(int count)
+{
+	int j, k;
+	for(j = 0; j < count; j++) {
+		int i = pending[j];
+		for(k = 0; k < SUBSCRIBERS; k++) if(arrays.clock_callback[i][k]) arrays.clock_callback[i][k]();
+		if(arrays.events[i]) arrays.nonrt_count[i]++;
+		if(arrays.waiters[i]) delivered++;
+		if(arrays.rings[i]) delivered += arrays.trigger[i];
+		if(arrays.storm[i].window) arrays.storm[i].count++;
+	}
+}
+static void __attribute__((noinline)) dispatch_structs(int count)
+{
+	int j, k;
+	for(j = 0; j < count; j++) {
+		struct source_state *state = &structs[pending[j]];
+		for(k = 0; k < SUBSCRIBERS; k++) if(state->clock_callback[k]) state->clock_callback[k]();
+		if(state->events) state->nonrt_count++;
+		if(state->waiters) delivered++;
+		if(state->rings) delivered += state->trigger;
+		if(state->storm.window) state->storm.count++;
+	}
+}
+
+static void flush(const void *p, size_t size)
+{
+	const char *c;
+	for(c = p; c < (const char *) p + size; c += LINE) __builtin_ia32_clflush(c);
+	__builtin_ia32_mfence();
+}
+static uint64_t measure(void (*dispatch)(int), int count)
+{
+	uint64_t best = ~0ULL;
+	int i;
+	for(i = 0; i < RUNS; i++) {
+		uint64_t start;
+		flush(&arrays, sizeof(arrays));
+		flush(structs, sizeof(structs));
+		start = rdtsc();
+		dispatch(count);
+		start = rdtsc() - start;
+		if(start < best) best = start;
+	}
+	return best;
+}
+
+/* The number of distinct cache lines of the addresses in p. */
+static int lines(const void *p[], int n)
+{
+	int i, j, ret = 0;
+	for(i = 0; i < n; i++) {
+		for(j = 0; j < i; j++) if((uintptr_t) p[i] / LINE == (uintptr_t) p[j] / LINE) break;
+		if(j == i) ret++;
+	}
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	const int reasons = FPGA1_INT0_T7_INT_NONE - FPGA1_INT0_T7_INT_RISING + 1;
+	/* The sources pending in the 4 sources case: a busy cycle. */
+	const int some[] = {
+		FPGA1_INT0_TIMER0_IRQ_RISING, FPGA1_INT0_T7_INT_RISING,
+		FPGA1_INT0_PNIO_IRT_RISING, FPGA1_INT4_T0_WATCHDOG_RISING
+	};
+	const int counts[] = {1, ARRAY_NUMBER(some), SOURCES};
+	const int i = some[0] / reasons;
+	const void *members[] = {
+		&arrays.clock_callback[i][0], &arrays.clock_callback[i][SUBSCRIBERS - 1],
+		&arrays.events[i], &arrays.nonrt_count[i], &arrays.trigger[i],
+		&arrays.storm[i].window, &arrays.storm[i].count, &arrays.rings[i],
+		&arrays.eventfd_count[i], &arrays.waiters[i]
+	};
+	const void *member[] = {
+		&structs[i].clock_callback[0], &structs[i].clock_callback[SUBSCRIBERS - 1],
+		&structs[i].events, &structs[i].nonrt_count, &structs[i].trigger,
+		&structs[i].storm.window, &structs[i].storm.count, &structs[i].rings,
+		&structs[i].eventfd_count, &structs[i].waiters
+	};
+	int j, k;
+
+	for(j = 0; j < SOURCES; j++) {
+		arrays.clock_callback[j][0] = structs[j].clock_callback[0] = clock_callback;
+		arrays.storm[j].window = structs[j].storm.window = 1;
+	}
+	printf("cache lines per source: arrays %d, structs %d\n", lines(members, ARRAY_NUMBER(members)), lines(member, ARRAY_NUMBER(member)));
+	for(j = 0; j < ARRAY_NUMBER(counts); j++) {
+		for(k = 0; k < counts[j]; k++) pending[k] = counts[j] <= ARRAY_NUMBER(some) ? some[k] / reasons : k;
+		printf("%2d pending: arrays %5llu cycles, structs %5llu cycles\n", counts[j],
+		       (unsigned long long) measure(dispatch_arrays, counts[j]),
+		       (unsigned long long) measure(dispatch_structs, counts[j]));
+	}
+	return 0;
+}
@@ -0,0 +1,50 @@
+/*
+ * CPU555 FPGA1 driver test application
+ * Event ring consumer
+ *
+ * Copyright (C) Siemens AG, 2026
+ * All Rights Reserved
+ */
+
+/* Receives the occurrences of TIMER0 through an event ring instead */
+/* of signals and prints how many records were drained per wakeup.  */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include "fpga1.h"
+
+#define RECORDS 256
+
+int main(int argc, char *argv[])
+{
+	volatile struct gamecp_ring *ring;
+	uint32_t records = RECORDS, event = FPGA1_INT0_TIMER0_IRQ_RISING, tail;
+	int fd;
+
+	fd = open("/dev/fpga1-0", O_RDWR);
+	assert(fd >= 0);
+	assert(ioctl(fd, GAMECP_RING_CREATE, &records) == 0);
+	ring = mmap(NULL, GAMECP_RING_SIZE(RECORDS), PROT_READ | PROT_WRITE, MAP_SHARED, fd, GAMECP_RING);
+	assert(ring != MAP_FAILED);
+	assert(ioctl(fd, GAMECP_RING_ENABLE, &event) == 0);
+
+	for(tail = ring->tail;;) {
+		uint32_t head, n = 0;
+		assert(ioctl(fd, GAMECP_RING_WAIT) == 0);
+		head = ring->head;
+		__sync_synchronize();
+		for(; tail != head; tail++, n++) {
+			volatile struct gamecp_record *record = &ring->record[tail & (RECORDS - 1)];
+			printf("%u: %s at %llu, register %08x\n", record->sequence, gamecp_name(record->event),
+			       (unsigned long long) record->timestamp, record->snapshot);
+		}
+		__sync_synchronize();
+		ring->tail = tail;
+		printf("%u records, %u dropped so far\n", n, ring->dropped);
+	}
+	return 0;
+}
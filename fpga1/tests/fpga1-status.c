@@ -0,0 +1,45 @@
+/*
+ * CPU555 FPGA1 driver test application
+ * Status page monitor
+ *
+ * Copyright (C) Siemens AG, 2026
+ * All Rights Reserved
+ */
+
+/* Prints the status of all sources that occurred at least once, once */
+/* per second, by just reading the driver's status page. Apart from   */
+/* the sleep, no system call is needed to do so, so any number of     */
+/* these monitors may run without disturbing the device's users.      */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "fpga1.h"
+
+int main(int argc, char *argv[])
+{
+	const int reasons = FPGA1_INT0_T7_INT_NONE - FPGA1_INT0_T7_INT_RISING + 1;
+	const struct gamecp_status *status;
+	struct gamecp_status_source source;
+	int fd, i;
+
+	fd = open("/dev/fpga1-0", O_RDONLY);
+	assert(fd >= 0);
+	status = mmap(NULL, getpagesize(), PROT_READ, MAP_SHARED, fd, GAMECP_STATUS);
+	assert(status != MAP_FAILED);
+
+	for(;;) {
+		for(i = 0; i < status->sources; i++) {
+			gamecp_status_read(&status->source[i], &source);
+			if(!source.count) continue;
+			printf("%-32s %10u at %20llu, coalesced %u, storms %u%s\n", gamecp_name(i * reasons),
+			       source.count, (unsigned long long) source.timestamp, source.coalesced,
+			       source.storms, source.masked ? ", masked" : "");
+		}
+		printf("\n");
+		sleep(1);
+	}
+	return 0;
+}
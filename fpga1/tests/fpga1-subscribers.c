@@ -0,0 +1,116 @@
+/*
+ * CPU555 FPGA1 driver test application
+ * Several events and clocks per source
+ *
+ * Copyright (C) Siemens AG, 2026
+ * All Rights Reserved
+ */
+
+/* Registers GAMECP_SUBSCRIBERS events and clocks for the timer 7      */
+/* interrupt and as many clocks for the RTC interrupt, one of each     */
+/* source's clocks through a second file, and checks that one more is  */
+/* refused. Closing the second file must release just its own clocks, */
+/* so that exactly one more clock fits on each source afterwards.     */
+/* Finally, timer 7 fires once, which must send every event once and  */
+/* advance every clock of the source. */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <rt/rtime.h>
+#include "fpga1.h"
+
+/* Converts nanoseconds to timer 7 oneshot delay. */
+#define NSEC_TO_T7(x) (x / 20)
+
+static uint8_t *regs;
+
+static uint32_t read_reg32(unsigned int offset)
+{
+	return *(volatile uint32_t *)(regs + offset);
+}
+static void write_reg32(unsigned int offset, uint32_t val)
+{
+	*(volatile uint32_t *)(regs + offset) = val;
+}
+/* Registers GAMECP_SUBSCRIBERS clocks for event, the last one through */
+/* fd2, and checks that one more is refused. */
+static void fill_clocks(int fd, int fd2, int event, struct timespec *period, clockid_t *clockid)
+{
+	int k;
+	for(k = 0; k < GAMECP_SUBSCRIBERS; k++) {
+		clockid[k] = register_clock(k < GAMECP_SUBSCRIBERS - 1 ? fd : fd2, CLOCK_SYNC, event, period);
+		assert(clockid[k] >= 0);
+	}
+	assert(register_clock(fd, CLOCK_SYNC, event, period) < 0);
+}
+
+int main(int argc, char *argv[])
+{
+	struct timespec period = {0, 1000000}, to = {1, 0}, before[GAMECP_SUBSCRIBERS], after;
+	clockid_t t7[GAMECP_SUBSCRIBERS], rtc[GAMECP_SUBSCRIBERS];
+	struct sigevent event[GAMECP_SUBSCRIBERS + 1];
+	int fd, fd2, k, seen = 0;
+	siginfo_t info;
+	sigset_t set;
+
+	fd = open("/dev/fpga1-0", O_RDWR);
+	assert(fd >= 0);
+	fd2 = open("/dev/fpga1-0", O_RDWR);
+	assert(fd2 >= 0);
+	regs = mmap(NULL, FPGA1_REGISTERS_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, FPGA1_OFFSET_REGISTERS);
+	assert(regs != MAP_FAILED);
+	sigemptyset(&set);
+	sigaddset(&set, SIGRT0);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	/* The events of timer 7, each one telling its slot. */
+	for(k = 0; k <= GAMECP_SUBSCRIBERS; k++) {
+		memset(&event[k], 0, sizeof(event[k]));
+		assert(sigevent_set_notification(&event[k], 0, SIGRT0, pthread_self()) == 0);
+		event[k].sigev_value.sival_int = k;
+		if(k < GAMECP_SUBSCRIBERS) assert(event_create(fd, &event[k], FPGA1_INT0_T7_INT_RISING) == 0);
+		else assert(event_create(fd, &event[k], FPGA1_INT0_T7_INT_RISING) != 0);
+	}
+
+	/* The clocks of both sources. Closing fd2 releases the last */
+	/* clock of each, and nothing else. */
+	fill_clocks(fd, fd2, FPGA1_INT0_T7_INT_RISING, &period, t7);
+	fill_clocks(fd, fd2, FPGA1_INT0_RTC_INT_RISING, &period, rtc);
+	close(fd2);
+	t7[GAMECP_SUBSCRIBERS - 1] = register_clock(fd, CLOCK_SYNC, FPGA1_INT0_T7_INT_RISING, &period);
+	assert(t7[GAMECP_SUBSCRIBERS - 1] >= 0);
+	assert(register_clock(fd, CLOCK_SYNC, FPGA1_INT0_T7_INT_RISING, &period) < 0);
+	rtc[GAMECP_SUBSCRIBERS - 1] = register_clock(fd, CLOCK_SYNC, FPGA1_INT0_RTC_INT_RISING, &period);
+	assert(rtc[GAMECP_SUBSCRIBERS - 1] >= 0);
+	assert(register_clock(fd, CLOCK_SYNC, FPGA1_INT0_RTC_INT_RISING, &period) < 0);
+
+	/* A single occurrence reaches all of them. */
+	for(k = 0; k < GAMECP_SUBSCRIBERS; k++) {
+		assert(clock_settime(t7[k], &period) == 0);
+		assert(clock_gettime(t7[k], &before[k]) == 0);
+	}
+	write_reg32(FPGA1_REGS_TIMER7_CMP, read_reg32(FPGA1_REGS_TIMER7) + NSEC_TO_T7(period.tv_nsec));
+	while(seen != (1 << GAMECP_SUBSCRIBERS) - 1) {
+		assert(sigtimedwait(&set, &info, &to) == SIGRT0);
+		assert(info.si_value.sival_int >= 0 && info.si_value.sival_int < GAMECP_SUBSCRIBERS);
+		assert(!(seen & 1 << info.si_value.sival_int));
+		seen |= 1 << info.si_value.sival_int;
+	}
+	for(k = 0; k < GAMECP_SUBSCRIBERS; k++) {
+		assert(clock_gettime(t7[k], &after) == 0);
+		assert(after.tv_sec != before[k].tv_sec || after.tv_nsec != before[k].tv_nsec);
+	}
+	printf("%d events and clocks per source\n", GAMECP_SUBSCRIBERS);
+
+	/* Closing the last file releases everything else. */
+	close(fd);
+	return 0;
+}
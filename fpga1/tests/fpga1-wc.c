@@ -0,0 +1,71 @@
+/*
+ * CPU555 FPGA1 driver test application
+ * Write-combining mapping of the SOC1 RAM
+ *
+ * Copyright (C) Siemens AG, 2026
+ * All Rights Reserved
+ */
+
+/* Writes a process image of IMAGE bytes to the SOC1 RAM through a    */
+/* write-combining and through an uncached mapping and prints the     */
+/* cycles being spent for each, including the store fence that makes */
+/* the write-combined stores visible to the device. With PAT, a BAR   */
+/* that is mapped uncached anywhere cannot be mapped write-combining, */
+/* the kernel silently mapping it uncached instead, so the            */
+/* write-combining mapping is measured and removed first. Also checks */
+/* that mapping the registers write-combining is refused.             */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include "fpga1.h"
+
+#define IMAGE (64 * FPGA1_1KB)
+#define RUNS  100
+
+static inline uint64_t rdtsc(void)
+{
+	uint32_t lo, hi;
+	__asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+	return ((uint64_t) hi << 32) | lo;
+}
+static uint64_t measure(volatile uint32_t *image)
+{
+	uint64_t best = ~0ULL;
+	int i, j;
+	for(i = 0; i < RUNS; i++) {
+		uint64_t start = rdtsc();
+		for(j = 0; j < IMAGE / sizeof(*image); j++) image[j] = i + j;
+		__sync_synchronize();
+		start = rdtsc() - start;
+		if(start < best) best = start;
+	}
+	return best;
+}
+
+int main(int argc, char *argv[])
+{
+	volatile uint32_t *uc, *wc;
+	uint64_t cycles;
+	int fd;
+
+	fd = open("/dev/fpga1-0", O_RDWR);
+	assert(fd >= 0);
+	assert(mmap(NULL, FPGA1_REGISTERS_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+		    FPGA1_OFFSET_REGISTERS | GAMECP_WRITE_COMBINING) == MAP_FAILED && errno == EINVAL);
+
+	wc = mmap(NULL, IMAGE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, FPGA1_OFFSET_SOC1_RAM | GAMECP_WRITE_COMBINING);
+	assert(wc != MAP_FAILED);
+	cycles = measure(wc);
+	munmap((void *) wc, IMAGE);
+	uc = mmap(NULL, IMAGE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, FPGA1_OFFSET_SOC1_RAM);
+	assert(uc != MAP_FAILED);
+	/* The uncached mapping shows what was written last. */
+	assert(uc[IMAGE / sizeof(*uc) - 1] == RUNS - 1 + IMAGE / sizeof(*uc) - 1);
+	printf("write-combining:   %8llu cycles\n", (unsigned long long) cycles);
+	printf("uncached:          %8llu cycles\n", (unsigned long long) measure(uc));
+	return 0;
+}
@@ -79,6 +79,8 @@
 /* These defines are needed by both the user space applications and */
 /* the driver.                                                      */
 /********************************************************************/
+#include <linux/ioctl.h>
+#include <linux/types.h>
 /* Proper stringification ... */
 #define GAMECP_STRINGIFY_(x) #x
 /* ... and concatenation ... */
@@ -86,12 +88,218 @@
 /* need one indirection. */
 #define GAMECP_STRINGIFY(x) GAMECP_STRINGIFY_(x)
 #define GAMECP_CONCAT(x, y) GAMECP_CONCAT_(x, y)
-/* The driver's device file. */
-#define GAMECP_DEVICE "/dev/" GAMECP_STRINGIFY(GAMECP_NAME)
-/* The offset into a BAR must not become bigger than that value. */
+/* The device file of the first board. Board n gets the device file */
+/* GAMECP_DEVICE_PREFIX followed by n, with n counting from 0 in the */
+/* order the boards are probed. */
+#define GAMECP_DEVICE_PREFIX "/dev/" GAMECP_STRINGIFY(GAMECP_NAME) "-"
+#define GAMECP_DEVICE GAMECP_DEVICE_PREFIX "0"
+/* The offset into a BAR must not become bigger than half of that */
+/* value, the upper half being selected by GAMECP_WRITE_COMBINING. */
 #define GAMECP_BAR_WINDOW_SIZE 0x20000000UL
 /* May be used as the base for offsets being passed to mmap(). */
 #define GAMECP_BAR(x) (x * GAMECP_BAR_WINDOW_SIZE)
+/* Or'ed into the offset of a PCI BAR being passed to mmap(), maps   */
+/* it write-combining instead of uncached, so that the CPU may merge */
+/* stores into bursts. This is only allowed for memory BARs, i.e.    */
+/* the prefetchable ones and those the driver declares as memory,    */
+/* never for the registers, and mmap() fails with EINVAL otherwise.  */
+/* Stores to such a mapping are buffered and may become visible to  */
+/* the device late and in any order, also relative to stores to the  */
+/* uncached registers. So after writing a buffer, e.g. the process   */
+/* image, and before telling the device to use it through a          */
+/* register, a store fence (sfence, _mm_sfence() or                  */
+/* __sync_synchronize()) is needed. Reads are not cached and thus    */
+/* still see what the device wrote. Bursts are the largest when      */
+/* whole cache lines are written in ascending order. On x86 with PAT, */
+/* a BAR cannot be mapped write-combining as long as any uncached    */
+/* mapping of it exists, by whichever process, including a GAMECP_ALL */
+/* mapping: The kernel silently maps it uncached instead. So the     */
+/* write-combining mapping must be created first, or the uncached    */
+/* ones be removed before. */
+#define GAMECP_WRITE_COMBINING (GAMECP_BAR_WINDOW_SIZE / 2)
+/* The maximum number of events and of clocks per source, e.g. for    */
+/* several processes waiting for the same interrupt. All of them must */
+/* ask for the same reason, otherwise the later ones are refused with */
+/* EBUSY, as are those beyond this number. */
+#define GAMECP_SUBSCRIBERS 4
+/* The magic number of the ioctls beyond those needed by libaudis. */
+/* Numbers from GAMECP_IOC_EXTENDER on are left to the driver      */
+/* incarnation's gamecp_ioctl_extender(). */
+#define GAMECP_IOC_MAGIC 'G'
+#define GAMECP_IOC_EXTENDER 64
+/* NonRT events that occur again before the previous occurrence has  */
+/* been delivered are merged into one signal. GAMECP_GET_COALESCED   */
+/* returns the number of occurrences that were merged this way for  */
+/* event (any reason of the event identifier may be passed) since   */
+/* the last call and resets it. */
+struct gamecp_coalesced {
+	__u32 event;
+	__u32 count;
+};
+#define GAMECP_GET_COALESCED _IOWR(GAMECP_IOC_MAGIC, 0, struct gamecp_coalesced)
+/* Resets the latency histograms of drivers being built with */
+/* GAMECP_LATENCY=1, see <debugfs>/<device name>/latency. */
+#define GAMECP_RESET_LATENCY _IO(GAMECP_IOC_MAGIC, 1)
+/* May be passed to mmap() to map the read-only status page. The last */
+/* window that still fits into 32 bits is reserved for it, while the  */
+/* windows between the PCI BARs and this one remain available to      */
+/* gamecp_mmap_extender(). */
+#define GAMECP_STATUS GAMECP_BAR(7)
+/* The status of an interrupt source. All counters are cumulative.  */
+/* The timestamp is taken from the CPU's cycle counter (i.e. the TSC */
+/* on x86) when the interrupt handler was entered. */
+struct gamecp_status_source {
+	__u32 sequence;   /* odd while the driver updates the entry */
+	__u32 count;      /* occurrences */
+	__u64 timestamp;  /* cycle counter at the last occurrence */
+	__u32 coalesced;  /* NonRT occurrences merged into one signal */
+	__u32 storms;     /* how often the source was masked as storming */
+	__u32 masked;     /* non-zero while masked as storming */
+	__u32 reserved;
+};
+/* The status page, having one entry per GAMECP_INTERRUPTS item, */
+/* i.e. the entry of an event is source[event / number of reasons]. */
+struct gamecp_status {
+	__u32 sources;
+	__u32 reserved;
+	struct gamecp_status_source source[];
+};
+/* May be passed to mmap() to map all PCI memory BARs and the status  */
+/* page into one VMA instead of mapping them one by one. The size to  */
+/* be passed to mmap() and the offset of each BAR and of the status   */
+/* page within the mapping are returned by GAMECP_GET_LAYOUT. They    */
+/* remain the same as long as the board is present. Each BAR sits at  */
+/* an offset being a multiple of its size. The mapping uses normal    */
+/* pages only. BARs smaller than a page, I/O port BARs and, on        */
+/* kernels before 4.1, which cannot keep the status page read-only    */
+/* within a writable mapping, the status page are GAMECP_ABSENT. The  */
+/* BARs are mapped uncached, so a write-combining mapping as          */
+/* described above still needs an mmap() of its own, which only gets  */
+/* write-combining if created before this one. */
+#define GAMECP_ALL (GAMECP_STATUS + GAMECP_BAR_WINDOW_SIZE / 4)
+#define GAMECP_ABSENT 0xffffffff
+struct gamecp_layout {
+	__u32 size;
+	__u32 status;
+	__u32 bar[6];
+};
+#define GAMECP_GET_LAYOUT _IOR(GAMECP_IOC_MAGIC, 9, struct gamecp_layout)
+/* Each open file may have an event ring, i.e. a ring buffer of       */
+/* records being written by the interrupt handler for every           */
+/* occurrence of the sources enabled for the ring. After creating it  */
+/* with GAMECP_RING_CREATE, passing the number of records (a power of */
+/* 2 up to GAMECP_RING_MAX), it is mapped by passing GAMECP_RING and  */
+/* GAMECP_RING_SIZE(records) to mmap(). Sources are enabled for the   */
+/* ring by passing event identifier / reason combinations to          */
+/* GAMECP_RING_ENABLE, while passing the last reason disables them.   */
+/* The consumer reads the records from tail up to head and advances   */
+/* tail afterwards. If the ring is full, records are dropped, which   */
+/* shows as a gap in the sequence numbers. GAMECP_RING_WAIT sleeps    */
+/* until the ring is not empty, while RT threads may just poll head.  */
+/* Instead of mapping the ring, the records may also be fetched with  */
+/* read() in batches of whole records, each record going to one of   */
+/* the threads reading the same file, and poll() / epoll report the   */
+/* device as readable while the ring is not empty.                    */
+#define GAMECP_RING (GAMECP_STATUS + GAMECP_BAR_WINDOW_SIZE / 2)
+#define GAMECP_RING_MAX 65536
+struct gamecp_record {
+	__u32 sequence;   /* counts the records, including dropped ones */
+	__u32 event;      /* event identifier / reason combination */
+	__u64 timestamp;  /* cycle counter at handler entry, as above */
+	__u32 snapshot;   /* the source's interrupt source register */
+	__u32 reserved;
+};
+struct gamecp_ring {
+	__u32 head;       /* next record to be written, by the driver */
+	__u32 size;       /* number of records */
+	__u32 dropped;    /* records dropped due to a full ring */
+	__u32 reserved[13];
+	__u32 tail;       /* next record to be read, by the consumer */
+	__u32 reserved2[15];
+	struct gamecp_record record[];
+};
+#define GAMECP_RING_SIZE(records) (sizeof(struct gamecp_ring) + (records) * sizeof(struct gamecp_record))
+#define GAMECP_RING_CREATE _IOW(GAMECP_IOC_MAGIC, 2, __u32)
+#define GAMECP_RING_ENABLE _IOW(GAMECP_IOC_MAGIC, 3, __u32)
+#define GAMECP_RING_WAIT _IO(GAMECP_IOC_MAGIC, 4)
+/* Binds an eventfd to a source, or unbinds it again if the event's   */
+/* last reason is passed. Any number of eventfds may be bound to the  */
+/* same source, and each of them is signalled with the number of      */
+/* occurrences by the NonRT handler. Bindings end with the file that  */
+/* made them. */
+struct gamecp_eventfd {
+	__u32 event;
+	__s32 fd;
+};
+#define GAMECP_EVENTFD _IOW(GAMECP_IOC_MAGIC, 5, struct gamecp_eventfd)
+/* Sleeps until any of the sources in the sources bitmap occurs or   */
+/* until the absolute CLOCK_MONOTONIC time timeout (in ns, 0 waits   */
+/* forever) is reached, in which case -1 is returned with errno set  */
+/* to ETIMEDOUT. Bit i stands for source i, i.e. for event           */
+/* identifiers i * number of reasons up to (i + 1) * number of       */
+/* reasons - 1, and only the first GAMECP_WAIT_SOURCES sources may   */
+/* be waited for. The sources must have been enabled by a clock, an  */
+/* event, an event ring or an eventfd. On return, occurred has the   */
+/* bits of the sources that occurred while waiting, with the number  */
+/* of occurrences and the cycle counter at the last one in count[i]  */
+/* and timestamp[i]. */
+#define GAMECP_WAIT_SOURCES 64
+struct gamecp_wait {
+	__u64 sources;
+	__u64 timeout;
+	__u64 occurred;
+	__u32 count[GAMECP_WAIT_SOURCES];
+	__u64 timestamp[GAMECP_WAIT_SOURCES];
+};
+#define GAMECP_WAIT _IOWR(GAMECP_IOC_MAGIC, 6, struct gamecp_wait)
+/* Busy polling of a source, similar to NAPI, for threads on         */
+/* isolated cores whose cycles are too short for interrupt delivery. */
+/* GAMECP_BUSY_POLL_MODE allows busy polling for the source of event */
+/* (the reason is ignored), idle being the time in us without        */
+/* GAMECP_BUSY_POLL calls after which the source is switched back    */
+/* to interrupt delivery, while 0 disallows it again. The first      */
+/* GAMECP_BUSY_POLL call masks the source's interrupt, while the     */
+/* source must remain enabled by a clock, event, event ring or       */
+/* eventfd. Each call reads the source's interrupt source register   */
+/* into snapshot and, if the source is pending, acknowledges it and  */
+/* sets count to 1 and timestamp to the cycle counter. Other sources */
+/* of the same register are neither acknowledged nor lost, but are   */
+/* still delivered by the interrupt handler. A source has a single   */
+/* poller at a time, concurrent calls failing with EBUSY. Needs the  */
+/* optional gamecp_mask() function of the driver incarnation. */
+struct gamecp_busy_poll_mode {
+	__u32 event;
+	__u32 idle;
+};
+struct gamecp_busy_poll {
+	__u32 event;
+	__u32 count;
+	__u32 snapshot;
+	__u32 reserved;
+	__u64 timestamp;
+};
+#define GAMECP_BUSY_POLL_MODE _IOW(GAMECP_IOC_MAGIC, 7, struct gamecp_busy_poll_mode)
+#define GAMECP_BUSY_POLL _IOWR(GAMECP_IOC_MAGIC, 8, struct gamecp_busy_poll)
+#ifndef __KERNEL__
+/* Copies a consistent snapshot of a source's status from the mapped */
+/* status page, retrying while the driver updates the entry. */
+static inline void gamecp_status_read(const volatile struct gamecp_status_source *source, struct gamecp_status_source *copy)
+{
+	__u32 sequence;
+	do {
+		while((sequence = source->sequence) & 1);
+		__sync_synchronize();
+		copy->count = source->count;
+		copy->timestamp = source->timestamp;
+		copy->coalesced = source->coalesced;
+		copy->storms = source->storms;
+		copy->masked = source->masked;
+		__sync_synchronize();
+	} while(source->sequence != sequence);
+	copy->sequence = sequence;
+	copy->reserved = 0;
+}
+#endif
 /* Used to create enums. Look at the explanation above and */
 /* gamecp.h for a nice usage example showing why this is useful. */
 #define GAMECP_MAKE_EVENT(name) enum GAMECP_CONCAT(GAMECP_NAME,_events) {\
@@ -119,9 +327,8 @@ GAMECP_MAKE_EVENT(GAMECP_INTERRUPTS);
 /* being passed. The event reason is ignored. */
 static inline char *gamecp_name(int event) {
 	GAMECP_MAKE_NAME(GAMECP_INTERRUPTS);
-	enum GAMECP_INTERRUPT_REASONS {GAMECP_EVENT_ITEM(GAMECP_INTERRUPTS,)}; 
-	const int size[] = {GAMECP_EVENT_ITEM(GAMECP_INTERRUPTS,)};
-	return (char *) GAMECP_CONCAT(GAMECP_NAME,_event_names)[event / ARRAY_NUMBER(size)];
+	enum GAMECP_INTERRUPT_REASONS {GAMECP_EVENT_ITEM(GAMECP_INTERRUPTS,) GAMECP_INTERRUPTS_REASONS};
+	return (char *) GAMECP_CONCAT(GAMECP_NAME,_event_names)[event / GAMECP_INTERRUPTS_REASONS];
 }
 /* These generic macros now did their job and are now */
 /* only needed by the driver code.  Thus, we undef them */
@@ -134,13 +341,19 @@ static inline char *gamecp_name(int event) {
 /* unchanged and is useful to application code. */
 #ifndef __KERNEL__
 #undef GAMECP_NAME
+/* Tools that replay the driver's dispatch in user space (e.g. the */
+/* benchmarks in the tests directories) may define */
+/* GAMECP_KEEP_INTERRUPTS to keep access to the event table. */
+#ifndef GAMECP_KEEP_INTERRUPTS
 #undef GAMECP_INTERRUPTS
+#endif
 #undef GAMECP_EVENT_ITEM
 #undef GAMECP_STRINGIFY_
 #undef GAMECP_CONCAT_
 #undef GAMECP_STRINGIFY
 #undef GAMECP_CONCAT
 #undef GAMECP_DEVICE
+#undef GAMECP_DEVICE_PREFIX
 #undef GAMECP_MAKE_EVENT
 #undef GAMECP_LIST_GENERATOR
 #undef GAMECP_MAKE_NAME
@@ -150,20 +363,57 @@ static inline char *gamecp_name(int event) {
 /* (and will) not be included by user space applicatiions. */
 /***********************************************************/
 #else /* #ifdef __KERNEL__ */
+#include <linux/debugfs.h>
 #include <linux/errno.h>
+#include <linux/eventfd.h>
 #include <linux/fs.h>
+#include <linux/idr.h>
+#include <linux/interrupt.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
 #include <linux/miscdevice.h>
 #include <linux/mm.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/pci.h>
+#include <linux/poll.h>
+#include <linux/rculist.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/timex.h>
+#include <linux/uaccess.h>
 #include <linux/version.h>
+#include <linux/vmalloc.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
 #include <linux/signal.h> /* due to missing include in rt_driver.h */
 #include <linux/aud/rt_driver.h>
+#define CREATE_TRACE_POINTS
+#include "gamecp_trace.h"
 
 MODULE_AUTHOR("Christof Warlich");
 MODULE_DESCRIPTION("GAMECP driver");
 MODULE_LICENSE("GPL");
 
+static bool msix;
+module_param(msix, bool, S_IRUGO);
+MODULE_PARM_DESC(msix, "Route each interrupt source register to its own MSI-X vector, needs a device whose MSI-X entry i signals source register i");
+static int affinity[BITS_PER_LONG] = {[0 ... BITS_PER_LONG - 1] = -1};
+static int affinity_num;
+module_param_array(affinity, int, &affinity_num, S_IRUGO);
+MODULE_PARM_DESC(affinity, "CPU hint per interrupt vector, board after board, for irqbalance or /proc/irq/<irq>/smp_affinity, -1 gives none");
+static unsigned int storm_budget = 1000;
+module_param(storm_budget, uint, S_IRUGO);
+MODULE_PARM_DESC(storm_budget, "Occurrences per source and storm_window before it gets masked, 0 disables the check");
+static unsigned int storm_window = 10;
+module_param(storm_window, uint, S_IRUGO);
+MODULE_PARM_DESC(storm_window, "Storm detection window and initial back-off in ms");
+static unsigned int storm_loops = 64;
+module_param(storm_loops, uint, S_IRUGO);
+MODULE_PARM_DESC(storm_loops, "Handler passes per interrupt before all pending sources get masked, 0 means unlimited");
+/* Upper limit of the exponential back-off for storming sources. */
+#define GAMECP_STORM_BACKOFF_MAX (10 * HZ)
+
 /***********************************************************/
 /* Example of using the MAKE_ENUM and MAKE_ARRAY macros,   */
 /* including the definition and use of a third macro       */
@@ -233,59 +483,68 @@ int main(void) {
 #define GAMECP_ARRAY_ITEM(name, value) value,
 /* Actually generate the event value array. */
 GAMECP_MAKE_ARRAY(GAMECP_INTERRUPTS);
+/* The offsets of the shadowed interrupt control registers. */
+static const int gamecp_control_offsets[] = GAMECP_CONTROL_REGISTERS;
 
 /* These functions must be implemented to match the real hardware. */
 struct gamecp_device;
-static int gamecp_split(void);
 static void gamecp_ack(struct gamecp_device *gamecp, eventid_t event);
 static void gamecp_trigger(struct gamecp_device *gamecp, eventid_t event);
-static bool gamecp_store(struct gamecp_device *gamecp);
-static bool gamecp_test(struct gamecp_device *gamecp, eventid_t event);
+static bool gamecp_store(struct gamecp_device *gamecp, unsigned long regs, gamecp_reg_t *src_regs);
 static int gamecp_postinit(struct gamecp_device *gamecp);
 static void gamecp_preexit(struct gamecp_device *gamecp);
+/* This one is optional: If implemented, it must acknowledge all bits */
+/* being set in bits for the source register with index reg at once. */
+/* Otherwise, gamecp_ack() is called for every single bit.           */
+extern void gamecp_ack_register(struct gamecp_device *gamecp, int reg, gamecp_reg_t bits) __attribute__((weak));
+/* This one is optional as well, but needed for busy polling: It must */
+/* mask or unmask the interrupt of an event identifier / reason       */
+/* combination without changing its trigger, so that the source       */
+/* register still shows its occurrences. */
+extern void gamecp_mask(struct gamecp_device *gamecp, eventid_t event, bool mask) __attribute__((weak));
 
-/* Calculate bit position. */
-static inline int gamecp_bitposition(int indexAndBit)
-{
-	return 1UL << ((indexAndBit) & ((1 << gamecp_split()) - 1));
-}
-/* Calculate address identifier. */
-static inline int gamecp_registerid(int indexAndBit)
-{
-	return (indexAndBit) >> (sizeof(int) * 8 - gamecp_split());
-}
-
-/* We ensure that GAMECP_INTERRUPT_REASONS ... */
-enum GAMECP_INTERRUPT_REASONS {GAMECP_EVENT_ITEM(GAMECP_INTERRUPTS,)}; 
-/* ... and gamecp_numberOfReasons() are in sync with */
-/* the definition of GAMECP_EVENT_ITEM. */
-inline static size_t gamecp_numberOfReasons(void)
-{
-	const int size[] = {GAMECP_EVENT_ITEM(GAMECP_INTERRUPTS,)};
-	return ARRAY_NUMBER(size);
-}
+/* The number of interrupt sources per interrupt source register. */
+#define GAMECP_REG_BITS (sizeof(gamecp_reg_t) * 8)
+/* The driver incarnation must define GAMECP_SPLIT, i.e. how many of */
+/* the lower bits of the GAMECP_INTERRUPTS values are reserved for   */
+/* the bit position, before including its application interface.    */
+#ifndef GAMECP_SPLIT
+#error "GAMECP_SPLIT must be defined by the driver incarnation"
+#endif
+/* The bit number and the register index of a GAMECP_INTERRUPTS value. */
+#define GAMECP_VALUE_BIT(value) ((value) & ((1 << GAMECP_SPLIT) - 1))
+#define GAMECP_VALUE_REG(value) (((value) >> GAMECP_SPLIT) / sizeof(gamecp_reg_t))
 
-static size_t gamecp_numberOfRegisters(void)
-{
-	size_t ret = 1;
-	int store[ARRAY_NUMBER(GAMECP_INTERRUPTS)], i, j;
-	store[0] = gamecp_registerid(GAMECP_INTERRUPTS[0]);
-	for(i = 1; i < ARRAY_NUMBER(GAMECP_INTERRUPTS); i++) {
-		bool found = false;
-		int addressIdentifier = gamecp_registerid(GAMECP_INTERRUPTS[i]);
-		for(j = 0; j < ret; j++) {
-			if(store[j] == addressIdentifier) {
-				found = true;
-				break;
-			}
-		}
-		if(!found) {
-			store[ret] = addressIdentifier;
-			ret++;
-		}
-	}
-	return ret;
-}
+/* We ensure that GAMECP_INTERRUPT_REASONS and GAMECP_REASON_NUM */
+/* are in sync with the definition of GAMECP_EVENT_ITEM. Being a */
+/* constant, dividing by it costs a shift at most. */
+enum GAMECP_INTERRUPT_REASONS {GAMECP_EVENT_ITEM(GAMECP_INTERRUPTS,) GAMECP_REASON_NUM};
+/* The index of each source in GAMECP_INTERRUPTS, e.g. FPGA1_INT0_T7_INT_SOURCE. */
+#define GAMECP_SOURCE_ITEM(name, value) name##_SOURCE,
+enum GAMECP_CONCAT(GAMECP_NAME,_sources) {GAMECP_LIST_GENERATOR(GAMECP_INTERRUPTS, GAMECP_SOURCE_ITEM)};
+/* The number of source registers is the highest register index plus */
+/* one, which is the size of a union having an array of that size    */
+/* per source. */
+#define GAMECP_REG_NUM_ITEM(name, value) char name[GAMECP_VALUE_REG(value) + 1];
+union gamecp_reg_num {GAMECP_LIST_GENERATOR(GAMECP_INTERRUPTS, GAMECP_REG_NUM_ITEM)};
+#define GAMECP_REG_NUM sizeof(union gamecp_reg_num)
+/* The register index and the bit mask of each source, so that none */
+/* of them needs to be calculated at runtime. */
+struct gamecp_source {
+	unsigned short reg;
+	gamecp_reg_t bit;
+};
+#define GAMECP_SOURCE_MAP_ITEM(name, value) {GAMECP_VALUE_REG(value), (gamecp_reg_t) 1 << GAMECP_VALUE_BIT(value)},
+static const struct gamecp_source gamecp_sources[] = {GAMECP_LIST_GENERATOR(GAMECP_INTERRUPTS, GAMECP_SOURCE_MAP_ITEM)};
+/* Maps register index * GAMECP_REG_BITS + bit number to the related */
+/* GAMECP_INTERRUPTS index, or to -1 if unused. Bit numbers beyond */
+/* GAMECP_REG_BITS are refused by GAMECP_BIT_CHECK_ITEM at build time. */
+#define GAMECP_BIT_CHECK_ITEM(name, value) BUILD_BUG_ON(GAMECP_VALUE_BIT(value) >= GAMECP_REG_BITS);
+#define GAMECP_BIT_EVENT_ITEM(name, value) [GAMECP_VALUE_REG(value) * GAMECP_REG_BITS + GAMECP_VALUE_BIT(value)] = name##_SOURCE,
+static const short gamecp_bit_event[GAMECP_REG_NUM * GAMECP_REG_BITS] = {
+	[0 ... GAMECP_REG_NUM * GAMECP_REG_BITS - 1] = -1,
+	GAMECP_LIST_GENERATOR(GAMECP_INTERRUPTS, GAMECP_BIT_EVENT_ITEM)
+};
 
 /*********************************************************/
 /* The remaining part of the file just only contains the */
@@ -293,96 +552,905 @@ static size_t gamecp_numberOfRegisters(void)
 /* must implement.                                       */
 /*********************************************************/
 /* The central data structures of the driver. */
+#ifdef GAMECP_LATENCY
+/* Per CPU latency histograms, counting the cycles from handler entry */
+/* to dispatch and to delivery per source. Bucket k holds latencies  */
+/* of less than 2^k cycles that did not fit into bucket k - 1. */
+#define GAMECP_LATENCY_BUCKETS 32
+struct gamecp_latency {
+	u32 dispatch[ARRAY_NUMBER(GAMECP_INTERRUPTS)][GAMECP_LATENCY_BUCKETS];
+	u32 delivery[ARRAY_NUMBER(GAMECP_INTERRUPTS)][GAMECP_LATENCY_BUCKETS];
+	cycles_t min[ARRAY_NUMBER(GAMECP_INTERRUPTS)];
+	cycles_t max[ARRAY_NUMBER(GAMECP_INTERRUPTS)];
+};
+#endif
+/* Interrupt storm protection state of a source. */
+struct gamecp_storm {
+	unsigned long window;  /* start of the current budget window */
+	unsigned int count;    /* occurrences within that window */
+	bool masked;           /* masked due to a storm */
+	unsigned long unmask;  /* when to re-enable the masked source */
+	unsigned long backoff; /* current back-off in jiffies */
+	unsigned int storms;   /* how often the source was masked */
+};
+/* Busy polling state of a source. */
+struct gamecp_busy_state {
+	unsigned long idle;    /* allowed if non-zero, jiffies until switching back */
+	unsigned long last;    /* of the last GAMECP_BUSY_POLL call */
+	bool active;           /* being busy polled right now */
+	bool polling;          /* a GAMECP_BUSY_POLL call is reading the register */
+};
+/* An interrupt vector and the source registers being routed to it, */
+/* as a bitmap of source register indices. */
+struct gamecp_vector {
+	struct gamecp_device *gamecp;
+	unsigned int irq;
+	unsigned long regs;
+	/* Odd while the interrupt handler runs for this vector. */
+	unsigned int running;
+};
+/* The driver's view of an open file's event ring. head and dropped */
+/* are kept here, so that the consumer cannot corrupt them. */
+struct gamecp_ring_state {
+	/* Serializes interrupt handlers running for different vectors. */
+	rtx_spinlock_t lock;
+	/* Serializes read() calls of threads sharing the file. */
+	struct mutex read_lock;
+	struct gamecp_ring *ring;
+	unsigned int size;
+	unsigned int head;
+	unsigned int dropped;
+	int slot;
+	bool waiting;
+	bool polled;
+};
+/* An eventfd being bound to a source by an open file. */
+struct gamecp_eventfd_binding {
+	struct list_head node;
+	struct eventfd_ctx *ctx;
+	struct gamecp_private *owner;
+	struct rcu_head rcu;
+};
+/* Slot k of source i, as being registered with the event area and  */
+/* the clock framework. Slots are unrelated to the event identifier / */
+/* reason combinations, whose number per source, GAMECP_REASON_NUM,   */
+/* differs between the driver incarnations, so they must never be    */
+/* divided by GAMECP_REASON_NUM. */
+#define GAMECP_SLOT(i, k) ((i) * GAMECP_SUBSCRIBERS + (k))
+/* The state of a source, kept together so that gamecp_dispatch()  */
+/* touches one cache line per source instead of one per parallel   */
+/* array. The members up to and including storm.count are the ones */
+/* being used on every occurrence and fit into the first line, the  */
+/* counters being used for NonRT events and eventfds only follow.   */
+/* This favours the common case of few pending sources: With all    */
+/* sources pending at once, the parallel arrays were faster, as     */
+/* they touch fewer lines in total, see fpga1-layout. */
+struct gamecp_source_state {
+	void (*clock_callback[GAMECP_SUBSCRIBERS])(void);
+	/* The event rings receiving the source, as a bitmap of slots. */
+	unsigned long rings;
+	/* The number of GAMECP_WAIT callers. */
+	unsigned int waiters;
+	/* The events to be sent, as a bitmap of the source's slots in */
+	/* gamecp_device.ev. */
+	unsigned int events;
+	struct gamecp_storm storm;
+	/* Occurrences of the NonRT events and for the eventfds not    */
+	/* yet delivered. */
+	atomic_t nonrt_count;
+	atomic_t eventfd_count;
+	/* The event identifier / reason combination being programmed, */
+	/* which all clocks, events, event rings and eventfds of the   */
+	/* source share. Also needed to re-enable it after a storm.    */
+	eventid_t trigger;
+#ifdef GAMECP_LATENCY
+	/* Handler entry of the oldest undelivered NonRT occurrence. */
+	cycles_t nonrt_entry;
+#endif
+	/* Not used by the interrupt handler. */
+	atomic_t nonrt_coalesced;
+	/* The clock slots being used and their clock ids. */
+	unsigned int clocks;
+	int clock_id[GAMECP_SUBSCRIBERS];
+	/* The event slots being registered with the event area and */
+	/* those of them that need the trigger, i.e. whose sigevent  */
+	/* notifies at all. A slot is claimed before being           */
+	/* registered, so that no other subscriber can change the    */
+	/* trigger meanwhile. */
+	unsigned int ev_slots;
+	unsigned int ev_claimed;
+	struct gamecp_busy_state busy;
+	/* The eventfds, being read by the NonRT handler under RCU and */
+	/* changed with eventfd_lock held. */
+	struct list_head eventfds;
+} ____cacheline_aligned_in_smp;
+/* The maximum number of event rings per device. */
+#define GAMECP_RINGS BITS_PER_LONG
+/* The members being used by the interrupt handler come first, starting */
+/* on a cache line of their own, followed by the per-source state and   */
+/* the rest. kzalloc() takes the device from a power-of-two sized     */
+/* cache whose objects are naturally aligned, so the alignment holds. */
 struct gamecp_device {
+	void __iomem *regs ____cacheline_aligned_in_smp;
+	/* A bitmap of the source registers with at least one enabled */
+	/* source, so that only these need to be read and scanned, the */
+	/* snapshot of the source registers being taken by gamecp_store() */
+	/* in the interrupt handler, each vector writing only its own      */
+	/* registers, and the sources being busy polled per source         */
+	/* register, which the interrupt handler must leave alone. */
+	unsigned long active_regs;
+	gamecp_reg_t src_regs[GAMECP_REG_NUM];
+	gamecp_reg_t polled_bits[GAMECP_REG_NUM];
+	/* The page being mapped read-only at GAMECP_STATUS. */
+	struct gamecp_status *status;
+	/* The sources having an eventfd being bound and the NonRT */
+	/* events and eventfds having undelivered occurrences. */
+	DECLARE_BITMAP(eventfd_bound, ARRAY_NUMBER(GAMECP_INTERRUPTS));
+	DECLARE_BITMAP(nonrt_pending, ARRAY_NUMBER(GAMECP_INTERRUPTS));
+	DECLARE_BITMAP(eventfd_pending, ARRAY_NUMBER(GAMECP_INTERRUPTS));
+	/* The rings whose consumers and whether the GAMECP_WAIT callers */
+	/* need to be woken up by the NonRT handler. */
+	unsigned long ring_wakeup;
+	bool wait_wakeup;
+	bool storm_pending;
+	unsigned long storm_window;
+	/* Updated by the interrupt handlers of all vectors without a */
+	/* lock. */
+	atomic_t storm_loops_hit;
+	/* Pending sources having neither clock nor event. */
+	atomic_t unmatched;
+	unsigned long unmatched_traced;
+#ifdef GAMECP_LATENCY
+	struct gamecp_latency __percpu *latency;
+#endif
+	struct gamecp_source_state source[ARRAY_NUMBER(GAMECP_INTERRUPTS)];
+	/* rt_init_event_area() needs the events as an array of their */
+	/* own, GAMECP_SUBSCRIBERS slots per source. */
+	struct rt_event ev[ARRAY_NUMBER(GAMECP_INTERRUPTS) * GAMECP_SUBSCRIBERS];
+	/* The event rings. */
+	struct gamecp_ring_state *rings[GAMECP_RINGS];
+	/* Serializes the programming of the interrupt controller and */
+	/* the changes of the clocks, events, event rings, eventfds   */
+	/* and waiters per source. The interrupt handler only takes it */
+	/* to mask storming sources, see gamecp_sync_handlers(), so it */
+	/* gets a cache line of its own. */
+	rtx_spinlock_t rt_dev_lock ____cacheline_aligned_in_smp;
+	/* Shadow copies of the interrupt control registers, one row */
+	/* of GAMECP_REG_NUM registers per gamecp_control_offsets entry. */
+	gamecp_reg_t ctrl_regs[ARRAY_NUMBER(gamecp_control_offsets)][GAMECP_REG_NUM];
+	/* The enabled sources per source register. */
+	gamecp_reg_t enabled_bits[GAMECP_REG_NUM];
 	struct pci_dev *pci_dev;
-	void __iomem *regs;
+	/* Where GAMECP_ALL maps what. */
+	struct gamecp_layout layout;
 	struct miscdevice miscdev;
-	struct rt_event ev[ARRAY_NUMBER(GAMECP_INTERRUPTS)];
-	bool nonrt_event[ARRAY_NUMBER(GAMECP_INTERRUPTS)];
-	rtx_spinlock_t rt_dev_lock;
+	/* The instance number of the board and the name of its device */
+	/* file, its interrupt vectors and its debugfs directory.      */
+	int instance;
+	char name[32];
 	int event_handle;
-	void (*clock_callback[ARRAY_NUMBER(GAMECP_INTERRUPTS)])(void);
-	int clock_id[ARRAY_NUMBER(GAMECP_INTERRUPTS)];
-	size_t reason_num;
-	size_t reg_num;
-	void *src_regs;
+	struct delayed_work busy_work;
+	struct delayed_work storm_work;
+	/* Either one MSI vector for all source registers or, with    */
+	/* the msix module parameter, one MSI-X vector per register. */
+	struct gamecp_vector *vectors;
+	int vector_num;
+	bool msix;
+	struct dentry *debugfs;
+	/* The wait queues of the event ring consumers. */
+	wait_queue_head_t ring_wait[GAMECP_RINGS];
+	struct mutex eventfd_lock;
+	/* The wait queue of the GAMECP_WAIT callers. */
+	wait_queue_head_t wait_queue;
 	void *user_config;
 };
 struct gamecp_private {
 	struct gamecp_device *device;
+	struct gamecp_ring_state ring;
 };
-#if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,35)
-static struct gamecp_device *gamecp_device;
+/* The miscdevice in filp->private_data needs 2.6.35, ida_simple_get() */
+/* 3.1 and wait_event_interruptible_hrtimeout() 3.10. */
+#if LINUX_VERSION_CODE < KERNEL_VERSION(3,10,0)
+#error "gamecp needs a kernel of version 3.10 or later"
 #endif
+/* Hands out the instance numbers of the boards. */
+static DEFINE_IDA(gamecp_ida);
+
+/* Returns the shadow copy of the control register being described by */
+/* gamecp_control_offsets[control] for the source register index reg. */
+static inline gamecp_reg_t *gamecp_control(struct gamecp_device *gamecp, int control, int reg)
+{
+	return &gamecp->ctrl_regs[control][reg];
+}
+/* Updates both the shadow copy and the control register itself, but */
+/* only if the value changed. The register is never read back. Must */
+/* be called with rt_dev_lock held, unless during probe. */
+static inline void gamecp_control_write(struct gamecp_device *gamecp, int control, int reg, gamecp_reg_t value)
+{
+	gamecp_reg_t *shadow = gamecp_control(gamecp, control, reg);
+	if(*shadow == value) return;
+	*shadow = value;
+	iowrite32(value, gamecp->regs + gamecp_control_offsets[control] + reg * sizeof(gamecp_reg_t));
+}
+/* Initializes the shadow copies from the hardware, once. */
+static void gamecp_control_init(struct gamecp_device *gamecp)
+{
+	int i, r;
+	for(i = 0; i < ARRAY_NUMBER(gamecp_control_offsets); i++) {
+		for(r = 0; r < GAMECP_REG_NUM; r++) {
+			*gamecp_control(gamecp, i, r) = ioread32(gamecp->regs + gamecp_control_offsets[i] + r * sizeof(gamecp_reg_t));
+		}
+	}
+}
+/* Updates of the status page entry of source i are enclosed by these */
+/* two functions, see gamecp_status_read() for the reader's side. As   */
+/* the interrupt handler does not hold rt_dev_lock, the odd sequence   */
+/* also keeps other writers out. Writers other than the interrupt      */
+/* handler must hold rt_dev_lock, so that the handler cannot interrupt */
+/* them on the same CPU.                                               */
+static inline struct gamecp_status_source *gamecp_status_begin(struct gamecp_device *gamecp, int i)
+{
+	struct gamecp_status_source *source = &gamecp->status->source[i];
+	u32 sequence;
+	do {
+		while((sequence = ACCESS_ONCE(source->sequence)) & 1) cpu_relax();
+	} while(cmpxchg(&source->sequence, sequence, sequence + 1) != sequence);
+	return source;
+}
+static inline void gamecp_status_end(struct gamecp_status_source *source)
+{
+	smp_wmb();
+	source->sequence++;
+}
+/* Publishes the storm state of source i. */
+static void gamecp_status_storm(struct gamecp_device *gamecp, int i)
+{
+	struct gamecp_status_source *source = gamecp_status_begin(gamecp, i);
+	source->storms = gamecp->source[i].storm.storms;
+	source->masked = gamecp->source[i].storm.masked;
+	gamecp_status_end(source);
+}
+/* Programs the trigger for an event identifier / reason combination */
+/* and keeps track of the source registers having enabled sources.   */
+/* The last reason always disables the source. */
+static void gamecp_set_trigger(struct gamecp_device *gamecp, eventid_t event_reason)
+{
+	const struct gamecp_source *source = &gamecp_sources[event_reason / GAMECP_REASON_NUM];
+	struct gamecp_source_state *state = &gamecp->source[event_reason / GAMECP_REASON_NUM];
+	int reg = source->reg;
+	gamecp_trigger(gamecp, event_reason);
+	if(state->busy.active) gamecp_mask(gamecp, event_reason, true);
+	state->trigger = event_reason;
+	if(state->storm.masked) {
+		state->storm.masked = false;
+		gamecp_status_storm(gamecp, event_reason / GAMECP_REASON_NUM);
+	}
+	if(event_reason % GAMECP_REASON_NUM == GAMECP_REASON_NUM - 1) gamecp->enabled_bits[reg] &= ~source->bit;
+	else gamecp->enabled_bits[reg] |= source->bit;
+	if(gamecp->enabled_bits[reg]) set_bit(reg, &gamecp->active_regs);
+	else clear_bit(reg, &gamecp->active_regs);
+}
+/* Counts an occurrence of source i against its budget and returns */
+/* true if the source exceeded it. */
+static inline bool gamecp_storm_check(struct gamecp_device *gamecp, int i)
+{
+	struct gamecp_storm *storm = &gamecp->source[i].storm;
+	if(!storm_budget) return false;
+	if(time_after_eq(jiffies, storm->window + gamecp->storm_window)) {
+		storm->window = jiffies;
+		storm->count = 0;
+	}
+	return ++storm->count > storm_budget;
+}
+/* Masks the storming source i until gamecp_storm_work() re-enables */
+/* it. Sources that storm again soon after being re-enabled get    */
+/* twice the back-off of the previous time. */
+static void gamecp_storm_mask(struct gamecp_device *gamecp, int i)
+{
+	struct gamecp_storm *storm = &gamecp->source[i].storm;
+	unsigned long backoff = gamecp->storm_window;
+	if(storm->masked) return;
+	if(storm->storms && time_before(jiffies, storm->unmask + 2 * storm->backoff))
+		backoff = min(2 * storm->backoff, (unsigned long) GAMECP_STORM_BACKOFF_MAX);
+	storm->backoff = backoff;
+	storm->unmask = jiffies + backoff;
+	storm->masked = true;
+	storm->storms++;
+	gamecp_status_storm(gamecp, i);
+	gamecp_trigger(gamecp, i * GAMECP_REASON_NUM + GAMECP_REASON_NUM - 1);
+	/* Re-enabling is scheduled by the NonRT handler. */
+	gamecp->storm_pending = true;
+}
+static void gamecp_storm_work(struct work_struct *work)
+{
+	struct gamecp_device *gamecp = container_of(to_delayed_work(work), struct gamecp_device, storm_work);
+	unsigned long flags;
+	bool masked = false;
+	int i;
+	rtx_spin_lock_irqsave(&gamecp->rt_dev_lock, flags);
+	for(i = 0; i < ARRAY_NUMBER(GAMECP_INTERRUPTS); i++) {
+		struct gamecp_storm *storm = &gamecp->source[i].storm;
+		if(!storm->masked) continue;
+		if(time_before(jiffies, storm->unmask)) {
+			masked = true;
+			continue;
+		}
+		storm->masked = false;
+		storm->window = jiffies;
+		storm->count = 0;
+		gamecp_status_storm(gamecp, i);
+		gamecp_trigger(gamecp, gamecp->source[i].trigger);
+		if(gamecp->source[i].busy.active) gamecp_mask(gamecp, gamecp->source[i].trigger, true);
+	}
+	rtx_spin_unlock_irqrestore(&gamecp->rt_dev_lock, flags);
+	if(masked) schedule_delayed_work(&gamecp->storm_work, gamecp->storm_window);
+}
+/* Shows the number of unmatched occurrences in debugfs. */
+static int gamecp_unmatched_get(void *data, u64 *val)
+{
+	struct gamecp_device *gamecp = data;
+	*val = atomic_read(&gamecp->unmatched);
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(gamecp_unmatched_fops, gamecp_unmatched_get, NULL, "%llu\n");
+/* Shows the storm counters in debugfs. */
+static int gamecp_storm_show(struct seq_file *m, void *v)
+{
+	struct gamecp_device *gamecp = m->private;
+	int i;
+	seq_printf(m, "loop limit hit: %u\n", atomic_read(&gamecp->storm_loops_hit));
+	for(i = 0; i < ARRAY_NUMBER(GAMECP_INTERRUPTS); i++) {
+		struct gamecp_storm *storm = &gamecp->source[i].storm;
+		if(!storm->storms) continue;
+		seq_printf(m, "%s: %u storms, back-off %u ms%s\n", gamecp_name(i * GAMECP_REASON_NUM), storm->storms,
+			   jiffies_to_msecs(storm->backoff), storm->masked ? ", masked" : "");
+	}
+	return 0;
+}
+static int gamecp_storm_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, gamecp_storm_show, inode->i_private);
+}
+static const struct file_operations gamecp_storm_fops = {
+	.owner = THIS_MODULE,
+	.open = gamecp_storm_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+/* Shows the shadow copies in debugfs as offset: value pairs. */
+static int gamecp_control_show(struct seq_file *m, void *v)
+{
+	struct gamecp_device *gamecp = m->private;
+	unsigned long flags;
+	int i, r;
+	rtx_spin_lock_irqsave(&gamecp->rt_dev_lock, flags);
+	for(i = 0; i < ARRAY_NUMBER(gamecp_control_offsets); i++) {
+		for(r = 0; r < GAMECP_REG_NUM; r++) {
+			seq_printf(m, "%04zx: %08x\n", gamecp_control_offsets[i] + r * sizeof(gamecp_reg_t), *gamecp_control(gamecp, i, r));
+		}
+	}
+	rtx_spin_unlock_irqrestore(&gamecp->rt_dev_lock, flags);
+	return 0;
+}
+static int gamecp_control_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, gamecp_control_show, inode->i_private);
+}
+static const struct file_operations gamecp_control_fops = {
+	.owner = THIS_MODULE,
+	.open = gamecp_control_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/* Latency instrumentation. Unless the driver is built with     */
+/* GAMECP_LATENCY defined, all of these functions are empty, so */
+/* nothing remains on the hot path. */
+#ifdef GAMECP_LATENCY
+static inline void gamecp_latency_add(u32 *histogram, cycles_t entry)
+{
+	histogram[min(fls64(get_cycles() - entry), GAMECP_LATENCY_BUCKETS - 1)]++;
+}
+static inline void gamecp_latency_dispatch(struct gamecp_device *gamecp, int i, cycles_t entry)
+{
+	gamecp_latency_add(this_cpu_ptr(gamecp->latency)->dispatch[i], entry);
+}
+static inline void gamecp_latency_delivery(struct gamecp_device *gamecp, int i, cycles_t entry)
+{
+	struct gamecp_latency *latency = this_cpu_ptr(gamecp->latency);
+	cycles_t delta = get_cycles() - entry;
+	gamecp_latency_add(latency->delivery[i], entry);
+	if(!latency->min[i] || delta < latency->min[i]) latency->min[i] = delta;
+	if(delta > latency->max[i]) latency->max[i] = delta;
+}
+static inline void gamecp_latency_defer(struct gamecp_device *gamecp, int i, cycles_t entry, int count)
+{
+	if(count == 1) gamecp->source[i].nonrt_entry = entry;
+}
+static inline cycles_t gamecp_latency_deferred(struct gamecp_device *gamecp, int i)
+{
+	return gamecp->source[i].nonrt_entry;
+}
+static void gamecp_latency_reset(struct gamecp_device *gamecp)
+{
+	int cpu;
+	for_each_possible_cpu(cpu) memset(per_cpu_ptr(gamecp->latency, cpu), 0, sizeof(struct gamecp_latency));
+}
+/* Shows the histograms of all CPUs summed up in debugfs. */
+static int gamecp_latency_show(struct seq_file *m, void *v)
+{
+	struct gamecp_device *gamecp = m->private;
+	struct gamecp_latency *sum;
+	int cpu, i, k;
+	sum = kzalloc(sizeof(*sum), GFP_KERNEL);
+	if(!sum) return -ENOMEM;
+	for_each_possible_cpu(cpu) {
+		struct gamecp_latency *latency = per_cpu_ptr(gamecp->latency, cpu);
+		for(i = 0; i < ARRAY_NUMBER(GAMECP_INTERRUPTS); i++) {
+			for(k = 0; k < GAMECP_LATENCY_BUCKETS; k++) {
+				sum->dispatch[i][k] += latency->dispatch[i][k];
+				sum->delivery[i][k] += latency->delivery[i][k];
+			}
+			if(latency->min[i] && (!sum->min[i] || latency->min[i] < sum->min[i])) sum->min[i] = latency->min[i];
+			if(latency->max[i] > sum->max[i]) sum->max[i] = latency->max[i];
+		}
+	}
+	for(i = 0; i < ARRAY_NUMBER(GAMECP_INTERRUPTS); i++) {
+		if(!sum->max[i]) continue;
+		seq_printf(m, "%s: min %llu, max %llu cycles\n", gamecp_name(i * GAMECP_REASON_NUM),
+			   (unsigned long long) sum->min[i], (unsigned long long) sum->max[i]);
+		seq_puts(m, "  < 2^k cycles   dispatch   delivery\n");
+		for(k = 0; k < GAMECP_LATENCY_BUCKETS; k++) {
+			if(sum->dispatch[i][k] || sum->delivery[i][k])
+				seq_printf(m, "  %12d %10u %10u\n", k, sum->dispatch[i][k], sum->delivery[i][k]);
+		}
+	}
+	kfree(sum);
+	return 0;
+}
+static int gamecp_latency_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, gamecp_latency_show, inode->i_private);
+}
+static const struct file_operations gamecp_latency_fops = {
+	.owner = THIS_MODULE,
+	.open = gamecp_latency_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+#else
+static inline void gamecp_latency_dispatch(struct gamecp_device *gamecp, int i, cycles_t entry) {}
+static inline void gamecp_latency_delivery(struct gamecp_device *gamecp, int i, cycles_t entry) {}
+static inline void gamecp_latency_defer(struct gamecp_device *gamecp, int i, cycles_t entry, int count) {}
+static inline cycles_t gamecp_latency_deferred(struct gamecp_device *gamecp, int i) {return 0;}
+#endif
+
+/* Writes a record for source i to the event ring in slot. */
+static inline void gamecp_ring_push(struct gamecp_device *gamecp, int slot, int i, cycles_t entry, gamecp_reg_t snapshot, bool *nonrt)
+{
+	struct gamecp_ring_state *state = ACCESS_ONCE(gamecp->rings[slot]);
+	struct gamecp_ring *ring;
+	struct gamecp_record *record;
+	/* The ring may just be going away. */
+	if(!state) return;
+	ring = state->ring;
+	rtx_spin_lock(&state->lock);
+	if(state->head - ACCESS_ONCE(ring->tail) >= state->size) {
+		ring->dropped = ++state->dropped;
+		rtx_spin_unlock(&state->lock);
+		return;
+	}
+	record = &ring->record[state->head & (state->size - 1)];
+	record->sequence = state->head + state->dropped;
+	record->event = gamecp->source[i].trigger;
+	record->timestamp = entry;
+	record->snapshot = snapshot;
+	smp_wmb();
+	ring->head = ++state->head;
+	rtx_spin_unlock(&state->lock);
+	/* Pairs with the barriers in gamecp_ring_sleep() and          */
+	/* gamecp_poll(). Waking up a sleeping or polling consumer is  */
+	/* left to the NonRT handler. */
+	smp_mb();
+	if(state->waiting || state->polled) {
+		set_bit(slot, &gamecp->ring_wakeup);
+		*nonrt = true;
+	}
+}
+
+/* The interrupt handler reads the clocks, events, event rings,       */
+/* eventfds and waiters per source without taking rt_dev_lock. So     */
+/* after removing any of them with rt_dev_lock held, the lock must be */
+/* released and this function must be called before the removed item */
+/* may be freed, to wait for interrupt handlers that might still be   */
+/* using it. */
+static void gamecp_sync_handlers(struct gamecp_device *gamecp)
+{
+	int i;
+	smp_mb();
+	for(i = 0; i < gamecp->vector_num; i++) {
+		unsigned int running = ACCESS_ONCE(gamecp->vectors[i].running);
+		if(running & 1) {
+			while(ACCESS_ONCE(gamecp->vectors[i].running) == running) cpu_relax();
+		}
+	}
+}
+
+/* Delivers the interrupt of GAMECP_INTERRUPTS entry i, which has  */
+/* already been acknowledged. For a source having several consumers, */
+/* the clock callback always runs first, followed by sending the RT  */
+/* event (or counting the NonRT event), counting for eventfds and    */
+/* waiters and finally writing the event rings' records. So an RT    */
+/* thread woken up by the event sees the clock already advanced. The */
+/* NonRT handler runs after all of them. */
+static inline void gamecp_dispatch(struct gamecp_device *gamecp, int i, bool *nonrt, cycles_t entry, gamecp_reg_t snapshot)
+{
+	struct gamecp_status_source *source = gamecp_status_begin(gamecp, i);
+	struct gamecp_source_state *state = &gamecp->source[i];
+	unsigned long events;
+	bool found = false, defer = false;
+	int k;
+	source->count++;
+	source->timestamp = entry;
+	gamecp_status_end(source);
+	/* The clocks, events and so on are published lock-free, see */
+	/* gamecp_sync_handlers(). */
+	gamecp_latency_dispatch(gamecp, i, entry);
+	trace_gamecp_dispatch(i, 1);
+	/* All clocks ... */
+	for(k = 0; k < GAMECP_SUBSCRIBERS; k++) {
+		void (*clock_callback)(void) = ACCESS_ONCE(state->clock_callback[k]);
+		if(clock_callback) {
+			clock_callback();
+			found = true;
+		}
+	}
+	/* ... events, the NonRT ones being left to the NonRT handler, ... */
+	events = ACCESS_ONCE(state->events);
+	for_each_set_bit(k, &events, GAMECP_SUBSCRIBERS) {
+		struct rt_event *ev = &gamecp->ev[GAMECP_SLOT(i, k)];
+		if(ev->ev_rt == EV_RT) {
+			if(rt_send_event(ev) == 0) found = true;
+		}
+		else defer = true;
+	}
+	if(defer) {
+		int count = atomic_inc_return(&state->nonrt_count);
+		gamecp_latency_defer(gamecp, i, entry, count);
+		trace_gamecp_nonrt_defer(i, count);
+		set_bit(i, gamecp->nonrt_pending);
+		*nonrt = true;
+		found = true;
+	}
+	/* ... eventfds ... */
+	if(test_bit(i, gamecp->eventfd_bound)) {
+		atomic_inc(&state->eventfd_count);
+		set_bit(i, gamecp->eventfd_pending);
+		*nonrt = true;
+		found = true;
+	}
+	/* ... GAMECP_WAIT callers, which register before checking the */
+	/* count, so the count being stored above must be visible      */
+	/* before waiters is read, or both sides could miss the other  */
+	/* and a wakeup would be lost. smp_wmb() in                   */
+	/* gamecp_status_end() does not order a store against a load. */
+	smp_mb();
+	if(ACCESS_ONCE(state->waiters)) {
+		gamecp->wait_wakeup = true;
+		*nonrt = true;
+		found = true;
+	}
+	/* ... and event rings may be registered for the same bit, ... */
+	if(state->rings) {
+		int slot;
+		for_each_set_bit(slot, &state->rings, GAMECP_RINGS) gamecp_ring_push(gamecp, slot, i, entry, snapshot, nonrt);
+		found = true;
+	}
+	/* ... but at least one must be there. As printing from here  */
+	/* would hurt latency, this is only counted and traced, the   */
+	/* latter at most once per jiffy. Handlers of other vectors  */
+	/* may race for the trace, but only one of them wins it. */
+	if(!found) {
+		unsigned long traced = ACCESS_ONCE(gamecp->unmatched_traced), now = jiffies;
+		int unmatched = atomic_inc_return(&gamecp->unmatched);
+		if(traced != now && cmpxchg(&gamecp->unmatched_traced, traced, now) == traced) trace_gamecp_unmatched(i, unmatched);
+	}
+	else gamecp_latency_delivery(gamecp, i, entry);
+}
 
 /* Common interrupt handler for clocks and events. */
 irqreturn_t gamecp_irq_handler(int irq, void *devid)
 {
-	struct gamecp_device *gamecp = devid;
-	int i;
+	struct gamecp_vector *vector = devid;
+	struct gamecp_device *gamecp = vector->gamecp;
+	gamecp_reg_t *regs = gamecp->src_regs;
+	/* Both the status page's timestamp and the latency */
+	/* instrumentation refer to the handler's entry. */
+	cycles_t entry = get_cycles();
+	unsigned long active;
+	int r, i, loops = 0;
 	bool nonrt = false;
-	rtx_spin_lock(&gamecp->rt_dev_lock);
+	trace_gamecp_irq_entry(irq);
+	vector->running++;
+	smp_mb();
 	/* We need to loop until no interrupts are pending so that a new edge may be generated */
-        while(gamecp_store(gamecp)) {
-		for(i = 0; i < ARRAY_NUMBER(GAMECP_INTERRUPTS); i++) {
-			int indexAndBit = GAMECP_INTERRUPTS[i];
-			if(gamecp_test(gamecp, i * gamecp->reason_num)) {
-                                bool found = false;
-                                /* Both clock ... */
-				if(gamecp->clock_callback[i]) {
-					gamecp->clock_callback[i]();
-                                        found = true;
-				}
-				/* ... and event may be registered for the same bit, ... */
-				if(gamecp->ev[i].ev_rt == EV_RT) {
-					if(rt_send_event(&gamecp->ev[i]) == 0) found = true;
-                                }
-				else {
-					gamecp->nonrt_event[i] = true;
-					nonrt = true;
-					found = true;
-				}
-                                /* ... but at least one must be there. */
-                                if(!found) printk(KERN_WARNING "Neither clock nor RT- or NonRT-event for event %s, register %x, bit %x\n",
-						  gamecp_name(i * gamecp_numberOfReasons()),
-						  gamecp_registerid(indexAndBit),
-						  gamecp_bitposition(indexAndBit));
-				/* The interrupting bit must be acknowledged in any case. */
-				gamecp_ack(gamecp, i * gamecp->reason_num);
+	while(gamecp_store(gamecp, active = gamecp->active_regs & vector->regs, regs)) {
+		/* But if that takes too long, all sources that are still */
+		/* pending are masked instead of being delivered. The     */
+		/* passes are counted in any case for the exit tracepoint. */
+		bool storm = ++loops > storm_loops && storm_loops;
+		bool any = false, mask = false;
+		/* The sources of this pass. */
+		DECLARE_BITMAP(deliver, ARRAY_NUMBER(GAMECP_INTERRUPTS));
+		bitmap_zero(deliver, ARRAY_NUMBER(GAMECP_INTERRUPTS));
+		/* First, the pending sources are collected and acknowledged. */
+		/* Only the bits being set in the snapshot of the registers   */
+		/* with enabled sources are visited, so the cost depends on   */
+		/* the number of pending sources, not on the size of          */
+		/* GAMECP_INTERRUPTS. */
+		for_each_set_bit(r, &active, GAMECP_REG_NUM) {
+			const short *bit_event = gamecp_bit_event + r * GAMECP_REG_BITS;
+			/* Busy polled sources are left to their poller. */
+			unsigned long pending = regs[r] & ~gamecp->polled_bits[r];
+			gamecp_reg_t handled = 0;
+			trace_gamecp_irq_snapshot(r, regs[r]);
+			if(pending) any = true;
+			while(pending) {
+				int bit = __fls(pending);
+				pending &= ~(1UL << bit);
+				if(bit_event[bit] < 0) continue;
+				__set_bit(bit_event[bit], deliver);
+				/* The interrupting bit must be acknowledged in any */
+				/* case, preferably together with its neighbours.   */
+				handled |= 1UL << bit;
+				if(!gamecp_ack_register) gamecp_ack(gamecp, bit_event[bit] * GAMECP_REASON_NUM);
+			}
+			if(handled) {
+				trace_gamecp_ack(r, handled);
+				if(gamecp_ack_register) gamecp_ack_register(gamecp, r, handled);
+			}
+		}
+		/* Then, the sources are delivered in the order of            */
+		/* GAMECP_INTERRUPTS, leaving only the storming ones in the   */
+		/* bitmap ... */
+		if(!storm) {
+			for_each_set_bit(i, deliver, ARRAY_NUMBER(GAMECP_INTERRUPTS)) {
+				gamecp_dispatch(gamecp, i, &nonrt, entry, regs[gamecp_sources[i].reg]);
+				if(gamecp_storm_check(gamecp, i)) mask = true;
+				else __clear_bit(i, deliver);
 			}
 		}
-        }
-        if(nonrt) execute_nonrt_handler(0, irq);
-	rtx_spin_unlock(&gamecp->rt_dev_lock);
+		/* ... which are masked with rt_dev_lock being taken once. */
+		if(storm || mask) {
+			rtx_spin_lock(&gamecp->rt_dev_lock);
+			for_each_set_bit(i, deliver, ARRAY_NUMBER(GAMECP_INTERRUPTS)) gamecp_storm_mask(gamecp, i);
+			rtx_spin_unlock(&gamecp->rt_dev_lock);
+		}
+		if(storm) {
+			atomic_inc(&gamecp->storm_loops_hit);
+			break;
+		}
+		if(!any) break;
+	}
+	if(nonrt || gamecp->storm_pending) execute_nonrt_handler(0, irq);
+	smp_mb();
+	vector->running++;
+	trace_gamecp_irq_exit(irq, loops);
 	return IRQ_HANDLED;
 }
 irqreturn_t gamecp_irq_nonrt_handler(int irq, void *devid)
 {
-	struct gamecp_device *gamecp = devid;
-	int i, ret;
-	for(i = 0; i < ARRAY_NUMBER(GAMECP_INTERRUPTS); i++) {
-		if(gamecp->nonrt_event[i]) {
-			ret = rt_send_event(&gamecp->ev[i]);
-			if(ret < 0) printk(KERN_WARNING "Failed to send NonRT-event %s, reason: %d\n", gamecp_name(i * gamecp_numberOfReasons()), ret);
-			gamecp->nonrt_event[i] = false;
+	struct gamecp_vector *vector = devid;
+	struct gamecp_device *gamecp = vector->gamecp;
+	unsigned long slots, events;
+	int i, k, ret, err, count;
+	if(xchg(&gamecp->storm_pending, false)) schedule_delayed_work(&gamecp->storm_work, gamecp->storm_window);
+	slots = xchg(&gamecp->ring_wakeup, 0);
+	for_each_set_bit(i, &slots, GAMECP_RINGS) wake_up_interruptible(&gamecp->ring_wait[i]);
+	if(xchg(&gamecp->wait_wakeup, false)) wake_up_interruptible_all(&gamecp->wait_queue);
+	for_each_set_bit(i, gamecp->eventfd_pending, ARRAY_NUMBER(GAMECP_INTERRUPTS)) {
+		struct gamecp_eventfd_binding *binding;
+		clear_bit(i, gamecp->eventfd_pending);
+		count = atomic_xchg(&gamecp->source[i].eventfd_count, 0);
+		if(!count) continue;
+		rcu_read_lock();
+		list_for_each_entry_rcu(binding, &gamecp->source[i].eventfds, node) eventfd_signal(binding->ctx, count);
+		rcu_read_unlock();
+	}
+	for_each_set_bit(i, gamecp->nonrt_pending, ARRAY_NUMBER(GAMECP_INTERRUPTS)) {
+		/* Occurrences that are counted after the bit has been  */
+		/* cleared set it again and are delivered by the next   */
+		/* run, so none of them is lost. */
+		cycles_t entry = gamecp_latency_deferred(gamecp, i);
+		clear_bit(i, gamecp->nonrt_pending);
+		count = atomic_xchg(&gamecp->source[i].nonrt_count, 0);
+		if(!count) continue;
+		/* All NonRT events of the source get the same occurrences. */
+		ret = 0;
+		events = ACCESS_ONCE(gamecp->source[i].events);
+		for_each_set_bit(k, &events, GAMECP_SUBSCRIBERS) {
+			struct rt_event *ev = &gamecp->ev[GAMECP_SLOT(i, k)];
+			if(ev->ev_rt == EV_RT) continue;
+			err = rt_send_event(ev);
+			if(err < 0) ret = err;
+		}
+		trace_gamecp_nonrt_deliver(i, count);
+		if(ret < 0) {
+			printk(KERN_WARNING "Failed to send NonRT-event %s, reason: %d\n", gamecp_name(i * GAMECP_REASON_NUM), ret);
+			/* The occurrences are handed back, so that the next run */
+			/* delivers them together with the ones arriving until then. */
+			if(atomic_add_return(count, &gamecp->source[i].nonrt_count) == count) gamecp_latency_defer(gamecp, i, entry, 1);
+			set_bit(i, gamecp->nonrt_pending);
+		}
+		else {
+			gamecp_latency_delivery(gamecp, i, entry);
+			if(count > 1) {
+				struct gamecp_status_source *source;
+				unsigned long flags;
+				atomic_add(count - 1, &gamecp->source[i].nonrt_coalesced);
+				rtx_spin_lock_irqsave(&gamecp->rt_dev_lock, flags);
+				source = gamecp_status_begin(gamecp, i);
+				source->coalesced += count - 1;
+				gamecp_status_end(source);
+				rtx_spin_unlock_irqrestore(&gamecp->rt_dev_lock, flags);
+			}
 		}
 	}
 	return IRQ_HANDLED;
 }
 
-/* Event registration and deregistration. */
+/* Interrupt vector setup and teardown. */
+static int gamecp_request_irqs(struct gamecp_device *gamecp)
+{
+	struct gamecp_vector *vectors;
+	struct msix_entry *entries;
+	int i, first, err;
+
+	vectors = kcalloc(GAMECP_REG_NUM, sizeof(*vectors), GFP_KERNEL);
+	if (!vectors) return -ENOMEM;
+	gamecp->vectors = vectors;
+	gamecp->vector_num = 0;
+
+	/* MSI-X entry i is expected to signal source register i. This */
+	/* cannot be read from the device and is not documented for    */
+	/* fpga1 or ich2, which is why MSI-X stays off by default: who  */
+	/* sets the msix module parameter must make sure that the       */
+	/* device's firmware routes its entries this way. A device      */
+	/* without MSI-X, or with fewer entries than source registers,  */
+	/* falls back to the single MSI vector.                         */
+	if (msix && GAMECP_REG_NUM > 1) {
+		entries = kcalloc(GAMECP_REG_NUM, sizeof(*entries), GFP_KERNEL);
+		if (entries) {
+			for(i = 0; i < GAMECP_REG_NUM; i++) entries[i].entry = i;
+#if LINUX_VERSION_CODE < KERNEL_VERSION(3,14,0)
+			err = pci_enable_msix(gamecp->pci_dev, entries, GAMECP_REG_NUM);
+#else
+			if (pci_msix_vec_count(gamecp->pci_dev) < GAMECP_REG_NUM) err = -EINVAL;
+			else err = pci_enable_msix_range(gamecp->pci_dev, entries, GAMECP_REG_NUM, GAMECP_REG_NUM) < 0;
+#endif
+			if (err == 0) {
+				for(i = 0; i < GAMECP_REG_NUM; i++) {
+					vectors[i].irq = entries[i].vector;
+					vectors[i].regs = 1UL << i;
+				}
+				gamecp->vector_num = GAMECP_REG_NUM;
+				gamecp->msix = true;
+			}
+			kfree(entries);
+		}
+		if (!gamecp->msix) dev_warn(&gamecp->pci_dev->dev, "MSI-X not available, using a single MSI vector\n");
+	}
+	if (!gamecp->msix) {
+		/*
+		 * Note: MSI / edge-triggering are mandatory as we do not
+		 * silence the IRQ sources in gamecp_irq_handler. But it is
+		 * also faster.
+		 */
+		err = pci_enable_msi(gamecp->pci_dev);
+		if (err) goto err_kfree;
+		vectors[0].irq = gamecp->pci_dev->irq;
+		vectors[0].regs = ~0UL;
+		gamecp->vector_num = 1;
+	}
+
+	/* The affinity entries are taken board after board, as many as */
+	/* each board would have vectors with the msix module parameter */
+	/* being honoured, so that a board falling back to MSI does not  */
+	/* shift the entries of the following ones. */
+	first = gamecp->instance * (msix && GAMECP_REG_NUM > 1 ? GAMECP_REG_NUM : 1);
+	for(i = 0; i < gamecp->vector_num; i++) {
+		int cpu = first + i < affinity_num ? affinity[first + i] : -1;
+		vectors[i].gamecp = gamecp;
+		err = rt_request_irq(vectors[i].irq, gamecp_irq_handler, 0, gamecp->name, &vectors[i], gamecp_irq_nonrt_handler);
+		if (err) goto err_free_irq;
+		/* irq_set_affinity() is not available to modules, so the */
+		/* CPU is only recorded as the affinity hint. Whether it   */
+		/* takes effect is up to the kernel version, irqbalance or */
+		/* the administrator writing /proc/irq/<irq>/smp_affinity. */
+		if (cpu >= 0 && cpu < nr_cpu_ids && cpu_online(cpu)) {
+			if (irq_set_affinity_hint(vectors[i].irq, cpumask_of(cpu)))
+				dev_warn(&gamecp->pci_dev->dev, "Cannot set affinity of vector %d to CPU %d\n", i, cpu);
+		}
+	}
+	return 0;
+
+err_free_irq:
+	/* The hints must be gone before the vectors are freed. */
+	while(--i >= 0) {
+		irq_set_affinity_hint(vectors[i].irq, NULL);
+		rt_free_irq(vectors[i].irq, &vectors[i]);
+	}
+	if (gamecp->msix) pci_disable_msix(gamecp->pci_dev);
+	else pci_disable_msi(gamecp->pci_dev);
+err_kfree:
+	kfree(vectors);
+	return err;
+}
+static void gamecp_free_irqs(struct gamecp_device *gamecp)
+{
+	int i;
+	for(i = 0; i < gamecp->vector_num; i++) {
+		irq_set_affinity_hint(gamecp->vectors[i].irq, NULL);
+		rt_free_irq(gamecp->vectors[i].irq, &gamecp->vectors[i]);
+	}
+	if (gamecp->msix) pci_disable_msix(gamecp->pci_dev);
+	else pci_disable_msi(gamecp->pci_dev);
+	kfree(gamecp->vectors);
+}
+
+/* Returns true if neither clock nor event nor event ring nor */
+/* eventfd needs source i anymore, so that it may be disabled. */
+static bool gamecp_source_unused(struct gamecp_device *gamecp, int i)
+{
+	struct gamecp_source_state *state = &gamecp->source[i];
+	return !state->rings && !state->clocks && !state->ev_claimed && !test_bit(i, gamecp->eventfd_bound);
+}
+/* Makes sure that the source of event_reason fires for its reason   */
+/* before a new clock, event, event ring or eventfd is added to it.   */
+/* All of them share the trigger of the source, so a reason that     */
+/* differs from the one of those already there is refused instead of */
+/* silently changing it for them. Must be called with rt_dev_lock    */
+/* held. */
+static int gamecp_claim(struct gamecp_device *gamecp, eventid_t event_reason)
+{
+	int i = event_reason / GAMECP_REASON_NUM;
+	if(gamecp_source_unused(gamecp, i)) gamecp_set_trigger(gamecp, event_reason);
+	else if(gamecp->source[i].trigger != event_reason) return -EBUSY;
+	return 0;
+}
+
+/* Event registration and deregistration. Every source has           */
+/* GAMECP_SUBSCRIBERS slots in the event area, so that as many events */
+/* may be bound to it, e.g. by different processes. */
 static int gamecp_event_disable(void *arg, struct rt_event *ev)
 {
 	struct gamecp_device *gamecp = arg;
-	gamecp_trigger(gamecp, ev->ev_id * gamecp->reason_num + gamecp->reason_num - 1);
+	struct gamecp_source_state *state;
+	unsigned long flags;
+	int i = ev->ev_id / GAMECP_SUBSCRIBERS;
+	unsigned int bit = 1U << ev->ev_id % GAMECP_SUBSCRIBERS;
+	state = &gamecp->source[i];
+	rtx_spin_lock_irqsave(&gamecp->rt_dev_lock, flags);
+	state->events &= ~bit;
+	state->ev_claimed &= ~bit;
+	state->ev_slots &= ~bit;
+	if(gamecp_source_unused(gamecp, i)) gamecp_set_trigger(gamecp, i * GAMECP_REASON_NUM + GAMECP_REASON_NUM - 1);
+	rtx_spin_unlock_irqrestore(&gamecp->rt_dev_lock, flags);
+	trace_gamecp_event_unbind(i * GAMECP_REASON_NUM, 0);
 	return 0;
 }
 static int gamecp_bind_irq_event(struct gamecp_private *gamecp_priv, struct rt_ev_desc __user *user_ev_desc)
 {
 	struct rt_ev_desc ev_desc;
 	struct gamecp_device *gamecp = gamecp_priv->device;
+	struct gamecp_source_state *state;
 	unsigned long flags;
-	int ret = 0;
+	unsigned int bit = 0;
+	bool notify;
+	int i, ret = 0;
 	enum GAMECP_CONCAT(GAMECP_NAME,_events) ev_id;
 
 	if (rt_copy_from_user(&ev_desc, user_ev_desc, sizeof(ev_desc))) return -EFAULT;
@@ -391,82 +1459,554 @@ static int gamecp_bind_irq_event(struct gamecp_private *gamecp_priv, struct rt_e
 	/* (RISING, FALLING, BOTH, NONE) ... */
 	ev_id = ev_desc.event;
 	/* ... so we must devide by the number of reasons ... */
-	ev_desc.event /= gamecp->reason_num;
-	if (ev_desc.event >= ARRAY_NUMBER(GAMECP_INTERRUPTS)) return -EINVAL;
+	i = ev_desc.event / GAMECP_REASON_NUM;
+	if (i >= ARRAY_NUMBER(GAMECP_INTERRUPTS)) return -EINVAL;
+	state = &gamecp->source[i];
+	notify = ev_desc.sigevent.sigev_notify != SIGEV_NONE;
+
+	/* ... to claim a free slot of the source, along with its      */
+	/* trigger as encoded in event if the event notifies at all.   */
+	/* We cannot do this in an fpga_event_enable() function,       */
+	/* because we don't have the event reason at this point any    */
+	/* more. Note however that if the event is deleted, the slot   */
+	/* _must_ be released in gamecp_event_disable(). It must be    */
+	/* done there because the event deletion may be done by the    */
+	/* kernel instead of a call to event_delete() being triggered  */
+	/* by the user. */
 	rtx_spin_lock_irqsave(&gamecp->rt_dev_lock, flags);
-	/* ... to register the event. */
-	ret = rt_register_event(gamecp->event_handle, &ev_desc);
+	if(state->ev_slots == (1U << GAMECP_SUBSCRIBERS) - 1) ret = -EBUSY;
+	else if(notify) ret = gamecp_claim(gamecp, ev_id);
+	if(!ret) {
+		bit = 1U << ffz(state->ev_slots);
+		state->ev_slots |= bit;
+		if(notify) state->ev_claimed |= bit;
+	}
+	rtx_spin_unlock_irqrestore(&gamecp->rt_dev_lock, flags);
 	if(ret) goto err_register_event;
 
-	/* If the event is registered, set mask and trigger registers as encoded in event. */
-	/* We cannot do this in an fpga_event_enable() function, because we don't have the */
-	/* event reason at this point any more. Note however that if the event is deleted, */
-	/* the event _must_ be masked in gamecp_event_disable(). It must be done there because the */
-	/* the event deletion may be done by the kernel instead of a call to event_delete() */
-	/* being triggered by the user. */
-	if(ev_desc.sigevent.sigev_notify != SIGEV_NONE) gamecp_trigger(gamecp, ev_id);
+	/* Then, the slot is registered ... */
+	ev_desc.event = GAMECP_SLOT(i, __ffs(bit));
+	ret = rt_register_event(gamecp->event_handle, &ev_desc);
 
-err_register_event:
+	/* ... and becomes visible to the interrupt handler, or is */
+	/* released again. */
+	rtx_spin_lock_irqsave(&gamecp->rt_dev_lock, flags);
+	if(ret) {
+		state->ev_slots &= ~bit;
+		state->ev_claimed &= ~bit;
+		if(gamecp_source_unused(gamecp, i)) gamecp_set_trigger(gamecp, i * GAMECP_REASON_NUM + GAMECP_REASON_NUM - 1);
+	}
+	else if(notify) ACCESS_ONCE(state->events) = state->events | bit;
 	rtx_spin_unlock_irqrestore(&gamecp->rt_dev_lock, flags);
+
+err_register_event:
+	trace_gamecp_event_bind(ev_id, ret);
 	return ret;
 }
 
-/* Clock registration and deregistration. */
-void clock_cleanup_callback(clocksrcid_t event, struct file *filp) {
+/* Clock registration and deregistration. Every source may drive up */
+/* to GAMECP_SUBSCRIBERS clocks. A clock is registered with its slot  */
+/* as clock source id, so that the cleanup callback knows which of    */
+/* the clocks of the source is gone, even if a file has several. */
+void clock_cleanup_callback(clocksrcid_t slot, struct file *filp) {
 	struct gamecp_private *gamecp_priv = filp->private_data;
 	struct gamecp_device *gamecp = gamecp_priv->device;
-        int r = gamecp->reason_num;
+	struct gamecp_source_state *state;
+	unsigned long flags;
+	int i = slot / GAMECP_SUBSCRIBERS, k = slot % GAMECP_SUBSCRIBERS;
+	if (i >= ARRAY_NUMBER(GAMECP_INTERRUPTS)) return;
+	state = &gamecp->source[i];
 	/* mask corresponding bit */
-	gamecp_trigger(gamecp, event / r * r + r - 1);
+	rtx_spin_lock_irqsave(&gamecp->rt_dev_lock, flags);
+	if(state->clocks & 1U << k) {
+		ACCESS_ONCE(state->clock_callback[k]) = NULL;
+		state->clock_id[k] = 0;
+		state->clocks &= ~(1U << k);
+		if(gamecp_source_unused(gamecp, i)) gamecp_set_trigger(gamecp, i * GAMECP_REASON_NUM + GAMECP_REASON_NUM - 1);
+	}
+	rtx_spin_unlock_irqrestore(&gamecp->rt_dev_lock, flags);
+	gamecp_sync_handlers(gamecp);
+	trace_gamecp_clock_unregister(i * GAMECP_REASON_NUM, 0);
 }
 static int gamecp_register_clock(struct gamecp_private *gamecp_priv,
 				struct file *filp,
 				struct rt_clock_desc __user *user_clock_desc)
 {
 	struct gamecp_device *gamecp = gamecp_priv->device;
+	struct gamecp_source_state *state;
 	void (*clock_callback)(void);
 	struct rt_clock_desc clock_desc;
 	unsigned long flags;
-	int ret;
+	int i, k, ret;
 	eventid_t event;
 
 	if (rt_copy_from_user(&clock_desc, user_clock_desc, sizeof(clock_desc))) return -EFAULT;
         event = clock_desc.clock_srcid;
+	i = event / GAMECP_REASON_NUM;
+	if (i >= ARRAY_NUMBER(GAMECP_INTERRUPTS)) return -EINVAL;
+	state = &gamecp->source[i];
+
+	/* A free slot of the source is claimed along with its trigger */
+	/* first, just like for events, ... */
+	rtx_spin_lock_irqsave(&gamecp->rt_dev_lock, flags);
+	k = ffz(state->clocks);
+	if(k >= GAMECP_SUBSCRIBERS) ret = -EBUSY;
+	else ret = gamecp_claim(gamecp, event);
+	if(!ret) state->clocks |= 1U << k;
+	rtx_spin_unlock_irqrestore(&gamecp->rt_dev_lock, flags);
+	if(ret) goto err_register_clock;
+
+	/* ... then, the clock is registered ... */
+	clock_desc.clock_srcid = GAMECP_SLOT(i, k);
 	clock_desc.clock_cleanup_callback = clock_cleanup_callback;
 	ret = rt_register_sync_clock(filp, &clock_desc, CLOCK_SYNC_HARD, &clock_callback);
-	if (ret < 0) return ret;
 
+	/* ... and becomes visible to the interrupt handler, or the */
+	/* slot is released again. */
 	rtx_spin_lock_irqsave(&gamecp->rt_dev_lock, flags);
-	gamecp->clock_callback[event / gamecp->reason_num] = clock_callback;
-	gamecp->clock_id[event / gamecp->reason_num] = ret;
-	gamecp_trigger(gamecp, event);
+	if(ret < 0) {
+		state->clocks &= ~(1U << k);
+		if(gamecp_source_unused(gamecp, i)) gamecp_set_trigger(gamecp, i * GAMECP_REASON_NUM + GAMECP_REASON_NUM - 1);
+	}
+	else {
+		state->clock_id[k] = ret;
+		ACCESS_ONCE(state->clock_callback[k]) = clock_callback;
+	}
 	rtx_spin_unlock_irqrestore(&gamecp->rt_dev_lock, flags);
 
+err_register_clock:
+	trace_gamecp_clock_register(event, ret);
 	return ret;
 }
 static int gamecp_unregister_clock(struct gamecp_private *gamecp_priv, struct file *filp, clockid_t clockid)
 {
 	struct gamecp_device *gamecp = gamecp_priv->device;
 	unsigned long flags;
-	int ret, i;
+	int ret, i, k = 0;
 
 	rtx_spin_lock_irqsave(&gamecp->rt_dev_lock, flags);
 	for(i = 0; i < ARRAY_NUMBER(GAMECP_INTERRUPTS); i++) {
-		if(gamecp->clock_id[i] == clockid) break;
+		struct gamecp_source_state *state = &gamecp->source[i];
+		for(k = 0; k < GAMECP_SUBSCRIBERS; k++) {
+			if((state->clocks & 1U << k) && state->clock_id[k] == clockid) break;
+		}
+		if(k < GAMECP_SUBSCRIBERS) break;
 	}
 	if(i < ARRAY_NUMBER(GAMECP_INTERRUPTS)) {
-		gamecp_trigger(gamecp, i * gamecp->reason_num + gamecp->reason_num - 1);
-		gamecp->clock_callback[i] = NULL;
-		gamecp->clock_id[i] = 0;
+		struct gamecp_source_state *state = &gamecp->source[i];
+		ACCESS_ONCE(state->clock_callback[k]) = NULL;
+		state->clock_id[k] = 0;
+		state->clocks &= ~(1U << k);
+		if(gamecp_source_unused(gamecp, i)) gamecp_set_trigger(gamecp, i * GAMECP_REASON_NUM + GAMECP_REASON_NUM - 1);
 	}
 	else printk(KERN_WARNING "%d is not a valid clock id\n", clockid);
 	rtx_spin_unlock_irqrestore(&gamecp->rt_dev_lock, flags);
+	gamecp_sync_handlers(gamecp);
 
 	ret = rt_unregister_sync_clock(filp, clockid);
+	trace_gamecp_clock_unregister(i * GAMECP_REASON_NUM, ret);
+
+	return ret;
+}
+
+/* Reporting of merged NonRT events. */
+static int gamecp_get_coalesced(struct gamecp_private *gamecp_priv, struct gamecp_coalesced __user *user_coalesced)
+{
+	struct gamecp_device *gamecp = gamecp_priv->device;
+	struct gamecp_coalesced coalesced;
+
+	if (rt_copy_from_user(&coalesced, user_coalesced, sizeof(coalesced))) return -EFAULT;
+	coalesced.event /= GAMECP_REASON_NUM;
+	if (coalesced.event >= ARRAY_NUMBER(GAMECP_INTERRUPTS)) return -EINVAL;
+	coalesced.count = atomic_xchg(&gamecp->source[coalesced.event].nonrt_coalesced, 0);
+	return put_user(coalesced.count, &user_coalesced->count);
+}
+
+/* Event rings. */
+static int gamecp_ring_create(struct gamecp_private *gamecp_priv, __u32 __user *user_size)
+{
+	struct gamecp_device *gamecp = gamecp_priv->device;
+	struct gamecp_ring_state *state = &gamecp_priv->ring;
+	struct gamecp_ring *ring;
+	unsigned long flags;
+	__u32 size;
+	int slot, ret = 0;
+
+	if (rt_copy_from_user(&size, user_size, sizeof(size))) return -EFAULT;
+	if (size < 2 || size > GAMECP_RING_MAX || !is_power_of_2(size)) return -EINVAL;
+	ring = vmalloc_user(GAMECP_RING_SIZE(size));
+	if (!ring) return -ENOMEM;
+	ring->size = size;
+
+	/* Threads sharing the file may race for its ring, so it is */
+	/* only checked with rt_dev_lock held. */
+	rtx_spin_lock_irqsave(&gamecp->rt_dev_lock, flags);
+	for(slot = 0; slot < GAMECP_RINGS; slot++) {
+		if(!gamecp->rings[slot]) break;
+	}
+	if(state->ring) ret = -EBUSY;
+	else if(slot == GAMECP_RINGS) ret = -ENOSPC;
+	else {
+		state->ring = ring;
+		state->size = size;
+		state->head = 0;
+		state->dropped = 0;
+		state->slot = slot;
+		state->waiting = false;
+		state->polled = false;
+		rtx_spin_lock_init(&state->lock);
+		/* The interrupt handler must see the ring's state first. */
+		smp_wmb();
+		ACCESS_ONCE(gamecp->rings[slot]) = state;
+	}
+	rtx_spin_unlock_irqrestore(&gamecp->rt_dev_lock, flags);
+	if(ret) vfree(ring);
+	return ret;
+}
+static int gamecp_ring_enable(struct gamecp_private *gamecp_priv, __u32 __user *user_event)
+{
+	struct gamecp_device *gamecp = gamecp_priv->device;
+	struct gamecp_ring_state *state = &gamecp_priv->ring;
+	unsigned long flags;
+	__u32 event;
+	int i, ret = 0;
+
+	if (rt_copy_from_user(&event, user_event, sizeof(event))) return -EFAULT;
+	i = event / GAMECP_REASON_NUM;
+	if (i >= ARRAY_NUMBER(GAMECP_INTERRUPTS)) return -EINVAL;
+	if (!state->ring) return -EINVAL;
+	rtx_spin_lock_irqsave(&gamecp->rt_dev_lock, flags);
+	/* The source is only disabled if nothing else needs it. */
+	if(event % GAMECP_REASON_NUM == GAMECP_REASON_NUM - 1) {
+		clear_bit(state->slot, &gamecp->source[i].rings);
+		if(gamecp_source_unused(gamecp, i)) gamecp_set_trigger(gamecp, event);
+	}
+	/* A ring being on its own may change the reason, so it gives */
+	/* up the source for claiming it again, keeping it otherwise.  */
+	else if(test_bit(state->slot, &gamecp->source[i].rings) && gamecp->source[i].trigger != event) {
+		clear_bit(state->slot, &gamecp->source[i].rings);
+		ret = gamecp_claim(gamecp, event);
+		set_bit(state->slot, &gamecp->source[i].rings);
+	}
+	else if(!(ret = gamecp_claim(gamecp, event))) set_bit(state->slot, &gamecp->source[i].rings);
+	rtx_spin_unlock_irqrestore(&gamecp->rt_dev_lock, flags);
+	return ret;
+}
+static inline bool gamecp_ring_empty(struct gamecp_ring_state *state)
+{
+	return ACCESS_ONCE(state->head) == ACCESS_ONCE(state->ring->tail);
+}
+static int gamecp_ring_sleep(struct gamecp_device *gamecp, struct gamecp_ring_state *state)
+{
+	int ret;
+	state->waiting = true;
+	/* Pairs with the barrier in gamecp_ring_push(). */
+	smp_mb();
+	ret = wait_event_interruptible(gamecp->ring_wait[state->slot], !gamecp_ring_empty(state));
+	state->waiting = false;
+	return ret;
+}
+static int gamecp_ring_wait(struct gamecp_private *gamecp_priv)
+{
+	if (!gamecp_priv->ring.ring) return -EINVAL;
+	return gamecp_ring_sleep(gamecp_priv->device, &gamecp_priv->ring);
+}
+static void gamecp_ring_destroy(struct gamecp_private *gamecp_priv)
+{
+	struct gamecp_device *gamecp = gamecp_priv->device;
+	struct gamecp_ring_state *state = &gamecp_priv->ring;
+	unsigned long flags;
+	int i;
+
+	if (!state->ring) return;
+	rtx_spin_lock_irqsave(&gamecp->rt_dev_lock, flags);
+	for(i = 0; i < ARRAY_NUMBER(GAMECP_INTERRUPTS); i++) {
+		if(!test_bit(state->slot, &gamecp->source[i].rings)) continue;
+		clear_bit(state->slot, &gamecp->source[i].rings);
+		if(gamecp_source_unused(gamecp, i)) gamecp_set_trigger(gamecp, i * GAMECP_REASON_NUM + GAMECP_REASON_NUM - 1);
+	}
+	ACCESS_ONCE(gamecp->rings[state->slot]) = NULL;
+	rtx_spin_unlock_irqrestore(&gamecp->rt_dev_lock, flags);
+	gamecp_sync_handlers(gamecp);
+	vfree(state->ring);
+	state->ring = NULL;
+}
+
+/* eventfd bindings. */
+static void gamecp_eventfd_free(struct rcu_head *rcu)
+{
+	struct gamecp_eventfd_binding *binding = container_of(rcu, struct gamecp_eventfd_binding, rcu);
+	eventfd_ctx_put(binding->ctx);
+	kfree(binding);
+}
+/* Must be called with eventfd_lock held. */
+static void gamecp_eventfd_unbind(struct gamecp_device *gamecp, int i, struct gamecp_eventfd_binding *binding)
+{
+	unsigned long flags;
+	list_del_rcu(&binding->node);
+	call_rcu(&binding->rcu, gamecp_eventfd_free);
+	if(!list_empty(&gamecp->source[i].eventfds)) return;
+	rtx_spin_lock_irqsave(&gamecp->rt_dev_lock, flags);
+	clear_bit(i, gamecp->eventfd_bound);
+	if(gamecp_source_unused(gamecp, i)) gamecp_set_trigger(gamecp, i * GAMECP_REASON_NUM + GAMECP_REASON_NUM - 1);
+	rtx_spin_unlock_irqrestore(&gamecp->rt_dev_lock, flags);
+}
+static int gamecp_eventfd(struct gamecp_private *gamecp_priv, struct gamecp_eventfd __user *user_eventfd)
+{
+	struct gamecp_device *gamecp = gamecp_priv->device;
+	struct gamecp_eventfd_binding *binding, *found = NULL;
+	struct gamecp_eventfd param;
+	struct eventfd_ctx *ctx;
+	unsigned long flags;
+	int i, ret = 0;
+
+	if (rt_copy_from_user(&param, user_eventfd, sizeof(param))) return -EFAULT;
+	i = param.event / GAMECP_REASON_NUM;
+	if (i >= ARRAY_NUMBER(GAMECP_INTERRUPTS)) return -EINVAL;
+	ctx = eventfd_ctx_fdget(param.fd);
+	if (IS_ERR(ctx)) return PTR_ERR(ctx);
+
+	mutex_lock(&gamecp->eventfd_lock);
+	list_for_each_entry(binding, &gamecp->source[i].eventfds, node) {
+		if(binding->ctx == ctx && binding->owner == gamecp_priv) found = binding;
+	}
+	if(param.event % GAMECP_REASON_NUM == GAMECP_REASON_NUM - 1) {
+		if(found) gamecp_eventfd_unbind(gamecp, i, found);
+		else ret = -ENOENT;
+	}
+	else if(found) ret = -EEXIST;
+	else {
+		binding = kmalloc(sizeof(*binding), GFP_KERNEL);
+		if(binding) {
+			rtx_spin_lock_irqsave(&gamecp->rt_dev_lock, flags);
+			ret = gamecp_claim(gamecp, param.event);
+			if(!ret) set_bit(i, gamecp->eventfd_bound);
+			rtx_spin_unlock_irqrestore(&gamecp->rt_dev_lock, flags);
+		}
+		else ret = -ENOMEM;
+		if(!ret) {
+			binding->ctx = ctx;
+			binding->owner = gamecp_priv;
+			list_add_tail_rcu(&binding->node, &gamecp->source[i].eventfds);
+			/* The binding keeps the reference. */
+			ctx = NULL;
+		}
+		else kfree(binding);
+	}
+	mutex_unlock(&gamecp->eventfd_lock);
+	if(ctx) eventfd_ctx_put(ctx);
+	return ret;
+}
+static void gamecp_eventfd_release(struct gamecp_private *gamecp_priv)
+{
+	struct gamecp_device *gamecp = gamecp_priv->device;
+	struct gamecp_eventfd_binding *binding, *next;
+	int i;
+
+	mutex_lock(&gamecp->eventfd_lock);
+	for(i = 0; i < ARRAY_NUMBER(GAMECP_INTERRUPTS); i++) {
+		list_for_each_entry_safe(binding, next, &gamecp->source[i].eventfds, node) {
+			if(binding->owner == gamecp_priv) gamecp_eventfd_unbind(gamecp, i, binding);
+		}
+	}
+	mutex_unlock(&gamecp->eventfd_lock);
+}
+
+/* Waiting for any of a set of sources. The occurrences are taken */
+/* from the status page's counters. */
+#define GAMECP_WAIT_NUM min_t(int, GAMECP_WAIT_SOURCES, ARRAY_NUMBER(GAMECP_INTERRUPTS))
+static bool gamecp_wait_done(struct gamecp_device *gamecp, u64 sources, const u32 *start)
+{
+	int i;
+	for(i = 0; i < GAMECP_WAIT_NUM; i++) {
+		if((sources >> i & 1) && ACCESS_ONCE(gamecp->status->source[i].count) != start[i]) return true;
+	}
+	return false;
+}
+static int gamecp_wait(struct gamecp_private *gamecp_priv, struct gamecp_wait __user *user_wait)
+{
+	struct gamecp_device *gamecp = gamecp_priv->device;
+	struct gamecp_wait *wait;
+	u32 start[GAMECP_WAIT_SOURCES];
+	unsigned long flags;
+	int i, ret;
 
+	wait = kmalloc(sizeof(*wait), GFP_KERNEL);
+	if (!wait) return -ENOMEM;
+	if (rt_copy_from_user(wait, user_wait, sizeof(*wait))) {
+		ret = -EFAULT;
+		goto out;
+	}
+	if (!wait->sources || (GAMECP_WAIT_NUM < 64 && wait->sources >> GAMECP_WAIT_NUM)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	/* The sources are only registered for the duration of the wait. */
+	rtx_spin_lock_irqsave(&gamecp->rt_dev_lock, flags);
+	for(i = 0; i < GAMECP_WAIT_NUM; i++) {
+		if(!(wait->sources >> i & 1)) continue;
+		gamecp->source[i].waiters++;
+		start[i] = gamecp->status->source[i].count;
+	}
+	rtx_spin_unlock_irqrestore(&gamecp->rt_dev_lock, flags);
+
+	if (wait->timeout)
+		ret = wait_event_interruptible_hrtimeout(gamecp->wait_queue, gamecp_wait_done(gamecp, wait->sources, start),
+							 ktime_sub(ns_to_ktime(wait->timeout), ktime_get()));
+	else ret = wait_event_interruptible(gamecp->wait_queue, gamecp_wait_done(gamecp, wait->sources, start));
+
+	rtx_spin_lock_irqsave(&gamecp->rt_dev_lock, flags);
+	wait->occurred = 0;
+	for(i = 0; i < GAMECP_WAIT_NUM; i++) {
+		struct gamecp_status_source *source = &gamecp->status->source[i];
+		wait->count[i] = 0;
+		wait->timestamp[i] = 0;
+		if(!(wait->sources >> i & 1)) continue;
+		gamecp->source[i].waiters--;
+		if(source->count == start[i]) continue;
+		wait->occurred |= 1ULL << i;
+		wait->count[i] = source->count - start[i];
+		wait->timestamp[i] = source->timestamp;
+	}
+	rtx_spin_unlock_irqrestore(&gamecp->rt_dev_lock, flags);
+
+	/* Occurrences win over both timeouts and signals. */
+	if (wait->occurred) ret = copy_to_user(user_wait, wait, sizeof(*wait)) ? -EFAULT : 0;
+	else if (ret == -ETIME) ret = -ETIMEDOUT;
+out:
+	kfree(wait);
 	return ret;
 }
 
+/* Busy polling. */
+static void gamecp_busy_start(struct gamecp_device *gamecp, int i)
+{
+	const struct gamecp_source *source = &gamecp_sources[i];
+	gamecp->source[i].busy.active = true;
+	gamecp->polled_bits[source->reg] |= source->bit;
+	gamecp_mask(gamecp, gamecp->source[i].trigger, true);
+}
+static void gamecp_busy_stop(struct gamecp_device *gamecp, int i)
+{
+	const struct gamecp_source *source = &gamecp_sources[i];
+	gamecp->source[i].busy.active = false;
+	gamecp->polled_bits[source->reg] &= ~source->bit;
+	/* Disabled and storming sources remain masked. */
+	if(gamecp->source[i].trigger % GAMECP_REASON_NUM != GAMECP_REASON_NUM - 1 && !gamecp->source[i].storm.masked)
+		gamecp_mask(gamecp, gamecp->source[i].trigger, false);
+}
+/* Switches sources back to interrupt delivery once their poller */
+/* became idle. Runs as long as any source is being busy polled, */
+/* being scheduled again by GAMECP_BUSY_POLL otherwise. A source  */
+/* whose register is being read by a poller right now is left to  */
+/* it, no matter how long the poller has been stalled. */
+static void gamecp_busy_work(struct work_struct *work)
+{
+	struct gamecp_device *gamecp = container_of(to_delayed_work(work), struct gamecp_device, busy_work);
+	unsigned long flags, period = ULONG_MAX;
+	int i;
+	rtx_spin_lock_irqsave(&gamecp->rt_dev_lock, flags);
+	for(i = 0; i < ARRAY_NUMBER(GAMECP_INTERRUPTS); i++) {
+		struct gamecp_busy_state *busy = &gamecp->source[i].busy;
+		if(!busy->active) continue;
+		if(!busy->polling && time_after(jiffies, busy->last + busy->idle)) gamecp_busy_stop(gamecp, i);
+		else period = min(period, busy->idle);
+	}
+	rtx_spin_unlock_irqrestore(&gamecp->rt_dev_lock, flags);
+	if(period != ULONG_MAX) schedule_delayed_work(&gamecp->busy_work, period);
+}
+static int gamecp_busy_poll_mode(struct gamecp_private *gamecp_priv, struct gamecp_busy_poll_mode __user *user_mode)
+{
+	struct gamecp_device *gamecp = gamecp_priv->device;
+	struct gamecp_busy_poll_mode mode;
+	struct gamecp_busy_state *busy;
+	unsigned long flags;
+	int i;
+
+	if (rt_copy_from_user(&mode, user_mode, sizeof(mode))) return -EFAULT;
+	i = mode.event / GAMECP_REASON_NUM;
+	if (i >= ARRAY_NUMBER(GAMECP_INTERRUPTS)) return -EINVAL;
+	if (!gamecp_mask) return -EOPNOTSUPP;
+	busy = &gamecp->source[i].busy;
+	rtx_spin_lock_irqsave(&gamecp->rt_dev_lock, flags);
+	if(mode.idle) busy->idle = max(usecs_to_jiffies(mode.idle), 1UL);
+	else {
+		/* A poller reading the register right now stops it itself. */
+		if(busy->active && !busy->polling) gamecp_busy_stop(gamecp, i);
+		busy->idle = 0;
+	}
+	rtx_spin_unlock_irqrestore(&gamecp->rt_dev_lock, flags);
+	return 0;
+}
+static int gamecp_busy_poll(struct gamecp_private *gamecp_priv, struct gamecp_busy_poll __user *user_poll)
+{
+	struct gamecp_device *gamecp = gamecp_priv->device;
+	/* The snapshot in gamecp->src_regs belongs to the interrupt */
+	/* handler, which does not take rt_dev_lock. */
+	gamecp_reg_t regs[GAMECP_REG_NUM];
+	struct gamecp_busy_poll poll;
+	struct gamecp_busy_state *busy;
+	unsigned long flags;
+	gamecp_reg_t bit;
+	bool started = false;
+	int i, reg, ret = 0;
+
+	if (rt_copy_from_user(&poll, user_poll, sizeof(poll))) return -EFAULT;
+	i = poll.event / GAMECP_REASON_NUM;
+	if (i >= ARRAY_NUMBER(GAMECP_INTERRUPTS)) return -EINVAL;
+	busy = &gamecp->source[i].busy;
+	reg = gamecp_sources[i].reg;
+	bit = gamecp_sources[i].bit;
+	poll.count = 0;
+	poll.timestamp = 0;
+	/* The lock only covers the bookkeeping. While busy->polling */
+	/* is set, the source stays masked and is neither handed back */
+	/* to the interrupt handler nor polled by anybody else, so    */
+	/* that the register may be read and acknowledged without the */
+	/* lock, just like the interrupt handler does. */
+	rtx_spin_lock_irqsave(&gamecp->rt_dev_lock, flags);
+	if(!busy->idle) ret = -EINVAL;
+	else if(busy->polling) ret = -EBUSY;
+	else {
+		if(!busy->active) {
+			gamecp_busy_start(gamecp, i);
+			started = true;
+		}
+		busy->polling = true;
+		busy->last = jiffies;
+	}
+	rtx_spin_unlock_irqrestore(&gamecp->rt_dev_lock, flags);
+	if (ret) return ret;
+	if (started) schedule_delayed_work(&gamecp->busy_work, busy->idle);
+	gamecp_store(gamecp, 1UL << reg, regs);
+	poll.snapshot = regs[reg];
+	/* Only the polled source is acknowledged, so that the interrupt */
+	/* handler still gets all the others. */
+	if (regs[reg] & bit) {
+		if (gamecp_ack_register) gamecp_ack_register(gamecp, reg, bit);
+		else gamecp_ack(gamecp, i * GAMECP_REASON_NUM);
+		poll.count = 1;
+		poll.timestamp = get_cycles();
+	}
+	/* Writers of the status page other than the interrupt handler */
+	/* must hold rt_dev_lock. */
+	rtx_spin_lock_irqsave(&gamecp->rt_dev_lock, flags);
+	if (poll.count) {
+		struct gamecp_status_source *source = gamecp_status_begin(gamecp, i);
+		source->count++;
+		source->timestamp = poll.timestamp;
+		gamecp_status_end(source);
+	}
+	busy->polling = false;
+	/* Polling was disallowed meanwhile. */
+	if (!busy->idle && busy->active) gamecp_busy_stop(gamecp, i);
+	rtx_spin_unlock_irqrestore(&gamecp->rt_dev_lock, flags);
+	return rt_copy_to_user(user_poll, &poll, sizeof(poll)) ? -EFAULT : 0;
+}
+
+/* Any ioctls beyond the generic ones, being optional as well. */
+extern long gamecp_ioctl_extender(struct file *filp, unsigned int cmd, unsigned long arg) __attribute__((weak));
 /* Required by libauidis. */
 static long gamecp_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
@@ -482,8 +2022,42 @@ static long gamecp_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	case AuD_UNREGISTER_CLOCK:
 		ret = gamecp_unregister_clock(gamecp_priv, filp, (clockid_t)arg);
 		break;
+	case GAMECP_GET_COALESCED:
+		ret = gamecp_get_coalesced(gamecp_priv, (struct gamecp_coalesced __user *)arg);
+		break;
+	case GAMECP_RING_CREATE:
+		ret = gamecp_ring_create(gamecp_priv, (__u32 __user *)arg);
+		break;
+	case GAMECP_RING_ENABLE:
+		ret = gamecp_ring_enable(gamecp_priv, (__u32 __user *)arg);
+		break;
+	case GAMECP_RING_WAIT:
+		ret = gamecp_ring_wait(gamecp_priv);
+		break;
+	case GAMECP_EVENTFD:
+		ret = gamecp_eventfd(gamecp_priv, (struct gamecp_eventfd __user *)arg);
+		break;
+	case GAMECP_WAIT:
+		ret = gamecp_wait(gamecp_priv, (struct gamecp_wait __user *)arg);
+		break;
+	case GAMECP_BUSY_POLL_MODE:
+		ret = gamecp_busy_poll_mode(gamecp_priv, (struct gamecp_busy_poll_mode __user *)arg);
+		break;
+	case GAMECP_BUSY_POLL:
+		ret = gamecp_busy_poll(gamecp_priv, (struct gamecp_busy_poll __user *)arg);
+		break;
+	case GAMECP_GET_LAYOUT:
+		ret = rt_copy_to_user((struct gamecp_layout __user *)arg, &gamecp_priv->device->layout, sizeof(struct gamecp_layout)) ? -EFAULT : 0;
+		break;
+#ifdef GAMECP_LATENCY
+	case GAMECP_RESET_LATENCY:
+		gamecp_latency_reset(gamecp_priv->device);
+		ret = 0;
+		break;
+#endif
 	default:
-		ret = -ENOTTY;
+		if(gamecp_ioctl_extender) ret = gamecp_ioctl_extender(filp, cmd, arg);
+		else ret = -ENOTTY;
 		break;
 	}
 	return ret;
@@ -492,21 +2066,140 @@ static long gamecp_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 extern int gamecp_mmap_extender(struct file *filp, struct vm_area_struct *vma) __attribute__((weak));
 /* PCI memory mapping. */
 #define GAMECP_BAR_WINDOW_MASK    (GAMECP_BAR_WINDOW_SIZE - 1)
-static int gamecp_mmap(struct file *filp, struct vm_area_struct *vma)
+/* The BARs that may be mapped with GAMECP_WRITE_COMBINING besides the */
+/* prefetchable ones, as a bitmap of BAR numbers. The driver incarnation */
+/* may define it for memory BARs that the device does not declare as    */
+/* prefetchable although writes to them have no side effects. */
+#ifndef GAMECP_WRITE_COMBINING_BARS
+#define GAMECP_WRITE_COMBINING_BARS 0
+#endif
+static bool gamecp_write_combining_allowed(struct pci_dev *dev, unsigned int bar_number)
+{
+	unsigned long flags = pci_resource_flags(dev, bar_number);
+	/* The registers must stay uncached in any case. */
+	if (bar_number == GAMECP_INTERRUPT_CONTROLLER_BAR) return false;
+	if (!(flags & IORESOURCE_MEM)) return false;
+	return (flags & IORESOURCE_PREFETCH) || (GAMECP_WRITE_COMBINING_BARS & 1 << bar_number);
+}
+/* The status page may only be mapped read-only, which mprotect() */
+/* must not be able to change later. */
+static int gamecp_mmap_status(struct gamecp_device *gamecp, struct vm_area_struct *vma)
+{
+	if (vma->vm_end - vma->vm_start > PAGE_SIZE) return -EINVAL;
+	if (vma->vm_flags & VM_WRITE) return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+	return remap_pfn_range(vma, vma->vm_start, virt_to_phys(gamecp->status) >> PAGE_SHIFT, PAGE_SIZE, vma->vm_page_prot);
+}
+/* Lays out the BARs for GAMECP_ALL, the biggest first. Their sizes   */
+/* being powers of 2, each of them then sits at an offset being a     */
+/* multiple of its size (which is also the alignment of its bus       */
+/* address) without any padding. */
+static void gamecp_layout_init(struct gamecp_device *gamecp, struct pci_dev *dev)
+{
+	struct gamecp_layout *layout = &gamecp->layout;
+	unsigned long len, offset = 0;
+	int i, bar;
+	for(i = 0; i < ARRAY_NUMBER(layout->bar); i++) layout->bar[i] = GAMECP_ABSENT;
+	for(;;) {
+		/* The biggest BAR not being laid out yet. */
+		for(i = 0, bar = -1, len = 0; i < ARRAY_NUMBER(layout->bar); i++) {
+			if(layout->bar[i] != GAMECP_ABSENT || !(pci_resource_flags(dev, i) & IORESOURCE_MEM)) continue;
+			if(pci_resource_len(dev, i) < PAGE_SIZE || pci_resource_len(dev, i) <= len) continue;
+			bar = i;
+			len = pci_resource_len(dev, i);
+		}
+		if(bar < 0) break;
+		layout->bar[bar] = offset;
+		offset += PAGE_ALIGN(len);
+	}
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4,1,0)
+	layout->status = GAMECP_ABSENT;
+#else
+	layout->status = offset;
+	offset += PAGE_SIZE;
+#endif
+	layout->size = offset;
+}
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,1,0)
+/* Within GAMECP_ALL, the status page is mapped read-only, but the VMA */
+/* is not, so a write would make its PTE writable unless refused here. */
+/* The VMA may have been split by mprotect() or a partial munmap(), so */
+/* the offset within the mapping is taken from vm_pgoff. */
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4,11,0)
+static int gamecp_all_pfn_mkwrite(struct vm_area_struct *vma, struct vm_fault *vmf)
+{
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4,10,0)
+	unsigned long address = (unsigned long) vmf->virtual_address;
+#else
+	unsigned long address = vmf->address;
+#endif
+#else
+static int gamecp_all_pfn_mkwrite(struct vm_fault *vmf)
+{
+	struct vm_area_struct *vma = vmf->vma;
+	unsigned long address = vmf->address;
+#endif
+	struct gamecp_private *gamecp_priv = vma->vm_file->private_data;
+	unsigned long offset = (address & PAGE_MASK) - vma->vm_start + (vma->vm_pgoff << PAGE_SHIFT) - GAMECP_ALL;
+	if (offset == gamecp_priv->device->layout.status) return VM_FAULT_SIGBUS;
+	return 0;
+}
+static const struct vm_operations_struct gamecp_all_vm_ops = {
+	.pfn_mkwrite = gamecp_all_pfn_mkwrite,
+};
+#endif
+static int gamecp_mmap_all(struct gamecp_device *gamecp, struct vm_area_struct *vma)
+{
+	struct gamecp_layout *layout = &gamecp->layout;
+	pgprot_t prot;
+	int i, ret;
+
+	if (vma->vm_end - vma->vm_start != layout->size) return -EINVAL;
+#if LINUX_VERSION_CODE < KERNEL_VERSION(3,7,0)
+	vma->vm_flags |= VM_IO | VM_RESERVED;
+#endif
+	prot = pgprot_noncached(vma->vm_page_prot);
+	for(i = 0; i < ARRAY_NUMBER(layout->bar); i++) {
+		if (layout->bar[i] == GAMECP_ABSENT) continue;
+		ret = remap_pfn_range(vma, vma->vm_start + layout->bar[i], pci_resource_start(gamecp->pci_dev, i) >> PAGE_SHIFT,
+				      PAGE_ALIGN(pci_resource_len(gamecp->pci_dev, i)), prot);
+		if (ret) return ret;
+	}
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,1,0)
+	/* Being RAM, the status page keeps the cache mode of the */
+	/* kernel's mapping. */
+	vma->vm_ops = &gamecp_all_vm_ops;
+	ret = remap_pfn_range(vma, vma->vm_start + layout->status, virt_to_phys(gamecp->status) >> PAGE_SHIFT, PAGE_SIZE,
+			      vm_get_page_prot(vma->vm_flags & ~VM_WRITE));
+	if (ret) return ret;
+#endif
+	return 0;
+}
+static int gamecp_mmap_bar(struct file *filp, struct vm_area_struct *vma)
 {
 	struct gamecp_private *gamecp_priv = filp->private_data;
 	unsigned long offset, size;
 	unsigned int bar_number;
 	phys_addr_t addr;
+	bool wc;
 
 	offset = vma->vm_pgoff << PAGE_SHIFT;
 	size = vma->vm_end - vma->vm_start;
 	bar_number = offset / GAMECP_BAR_WINDOW_SIZE;
 
+	if (offset == GAMECP_STATUS) return gamecp_mmap_status(gamecp_priv->device, vma);
+	if (offset == GAMECP_ALL) return gamecp_mmap_all(gamecp_priv->device, vma);
+	if (offset == GAMECP_RING) {
+		if (!gamecp_priv->ring.ring) return -EINVAL;
+		return remap_vmalloc_range(vma, gamecp_priv->ring.ring, 0);
+	}
 	if (bar_number > (PCI_BASE_ADDRESS_5 - PCI_BASE_ADDRESS_0) / sizeof(int32_t)) {
 		if(gamecp_mmap_extender) return gamecp_mmap_extender(filp, vma);
 		else return -EINVAL;
 	}
+	wc = offset & GAMECP_WRITE_COMBINING;
+	offset &= ~GAMECP_WRITE_COMBINING;
+	if (wc && !gamecp_write_combining_allowed(gamecp_priv->device->pci_dev, bar_number)) return -EINVAL;
 	/* do not allow mapping beyond the end of the windows */
 	if ((offset & GAMECP_BAR_WINDOW_MASK) + size >
 	    pci_resource_len(gamecp_priv->device->pci_dev, bar_number))
@@ -518,10 +2211,81 @@ static int gamecp_mmap(struct file *filp, struct vm_area_struct *vma)
 #if LINUX_VERSION_CODE < KERNEL_VERSION(3,7,0)
 	vma->vm_flags |= VM_IO | VM_RESERVED;
 #endif
-	vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
+	if (wc) vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
+	else vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
 
 	return remap_pfn_range(vma, vma->vm_start, addr >> PAGE_SHIFT, size, vma->vm_page_prot);
 }
+static int gamecp_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	int ret = gamecp_mmap_bar(filp, vma);
+	trace_gamecp_mmap(vma->vm_pgoff << PAGE_SHIFT, vma->vm_end - vma->vm_start, ret);
+	return ret;
+}
+
+/* To read() the records of the event ring, as an alternative to */
+/* mapping it. */
+static ssize_t gamecp_read(struct file *filp, char __user *buf, size_t count, loff_t *ppos)
+{
+	struct gamecp_private *gamecp_priv = filp->private_data;
+	struct gamecp_ring_state *state = &gamecp_priv->ring;
+	struct gamecp_ring *ring = state->ring;
+	unsigned int head, tail, n;
+	size_t done = 0;
+	ssize_t ret;
+
+	if (!ring) return -EINVAL;
+	if (count < sizeof(struct gamecp_record)) return -EINVAL;
+	/* Otherwise, concurrent readers would get the same records and */
+	/* race for the tail. A reader may sleep with the lock held.    */
+	if (filp->f_flags & O_NONBLOCK) {
+		if (!mutex_trylock(&state->read_lock)) return -EAGAIN;
+	}
+	else if (mutex_lock_interruptible(&state->read_lock)) return -ERESTARTSYS;
+	while (gamecp_ring_empty(state)) {
+		ret = -EAGAIN;
+		if (filp->f_flags & O_NONBLOCK) goto out;
+		ret = gamecp_ring_sleep(gamecp_priv->device, state);
+		if (ret) goto out;
+	}
+	head = ACCESS_ONCE(state->head);
+	/* Pairs with the barrier before publishing head. */
+	smp_rmb();
+	tail = ACCESS_ONCE(ring->tail);
+	/* The tail may have been messed up through the mapping. */
+	if (head - tail > state->size) tail = head - state->size;
+	n = min_t(size_t, head - tail, count / sizeof(struct gamecp_record));
+	while (n) {
+		unsigned int index = tail & (state->size - 1);
+		unsigned int chunk = min(n, state->size - index);
+		if (copy_to_user(buf + done, &ring->record[index], chunk * sizeof(struct gamecp_record))) break;
+		done += chunk * sizeof(struct gamecp_record);
+		tail += chunk;
+		n -= chunk;
+	}
+	/* The records must have been read before they may be overwritten. */
+	smp_mb();
+	ring->tail = tail;
+	ret = done ? done : -EFAULT;
+out:
+	mutex_unlock(&state->read_lock);
+	return ret;
+}
+/* The device is readable while the event ring is not empty. */
+static unsigned int gamecp_poll(struct file *filp, poll_table *wait)
+{
+	struct gamecp_private *gamecp_priv = filp->private_data;
+	struct gamecp_ring_state *state = &gamecp_priv->ring;
+
+	if (!state->ring) return POLLERR;
+	/* Once polled, the consumer is woken up for every record, as  */
+	/* epoll does not tell when it stops waiting. */
+	state->polled = true;
+	/* Pairs with the barrier in gamecp_ring_push(). */
+	smp_mb();
+	poll_wait(filp, &gamecp_priv->device->ring_wait[state->slot], wait);
+	return gamecp_ring_empty(state) ? 0 : POLLIN | POLLRDNORM;
+}
 
 /* To open() and close() the device. */
 static int gamecp_open(struct inode *inode, struct file *filp)
@@ -530,19 +2294,16 @@ static int gamecp_open(struct inode *inode, struct file *filp)
 	struct gamecp_device *gamecp;
 	int err;
 
-	gamecp_priv = kmalloc(sizeof(struct gamecp_private), GFP_KERNEL);
+	gamecp_priv = kzalloc(sizeof(struct gamecp_private), GFP_KERNEL);
 	if (!gamecp_priv) return -ENOMEM;
 
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,35)
 	/* The miscdevice layer puts the registered miscdevice structure
-	 * in filp->private_data. */
+	 * in filp->private_data, which tells the boards apart. */
 	gamecp_priv->device = container_of(filp->private_data, struct gamecp_device, miscdev);
-#else
-	gamecp_priv->device = gamecp_device;
-#endif
 	gamecp = gamecp_priv->device;
 
 	filp->private_data = gamecp_priv;
+	mutex_init(&gamecp_priv->ring.read_lock);
 
 	if (IS_REALTIME_PROCESS(current)) {
 		err = rt_allow_access(filp, RT_IO_IOCTL);
@@ -560,6 +2321,8 @@ static int gamecp_release(struct inode *inode, struct file *filp)
 
 	if (IS_REALTIME_PROCESS(current)) rt_remove_access(filp);
 
+	gamecp_ring_destroy(gamecp_priv);
+	gamecp_eventfd_release(gamecp_priv);
 	kfree(gamecp_priv);
 	return 0;
 }
@@ -569,6 +2332,8 @@ static const struct file_operations gamecp_fops = {
 	.owner = THIS_MODULE,
 	.open = gamecp_open,
 	.release = gamecp_release,
+	.read = gamecp_read,
+	.poll = gamecp_poll,
 	.unlocked_ioctl = gamecp_ioctl,
 	.mmap = gamecp_mmap,
 };
@@ -580,76 +2345,95 @@ static int gamecp_pci_probe(struct pci_dev *dev, const struct pci_device_id *id)
 	gamecp = kzalloc(sizeof(*gamecp), GFP_KERNEL);
 	if (!gamecp) return err;
 
-	gamecp->reason_num = gamecp_numberOfReasons();
-	gamecp->reg_num = gamecp_numberOfRegisters();
-	gamecp->src_regs =  kzalloc(sizeof(gamecp_reg_t) * gamecp->reg_num, GFP_KERNEL);
-	if (!gamecp->src_regs) goto err_kfree1;
+	/* Boards may be probed in parallel, which the IDA copes with. */
+	gamecp->instance = ida_simple_get(&gamecp_ida, 0, 0, GFP_KERNEL);
+	if (gamecp->instance < 0) {
+		err = gamecp->instance;
+		goto err_kfree1;
+	}
+	snprintf(gamecp->name, sizeof(gamecp->name), GAMECP_STRINGIFY(GAMECP_NAME) "-%d", gamecp->instance);
+
+	BUILD_BUG_ON(GAMECP_REG_NUM > BITS_PER_LONG);
+	GAMECP_LIST_GENERATOR(GAMECP_INTERRUPTS, GAMECP_BIT_CHECK_ITEM)
+	BUILD_BUG_ON(sizeof(struct gamecp_status) + sizeof(struct gamecp_status_source) * ARRAY_NUMBER(GAMECP_INTERRUPTS) > PAGE_SIZE);
+	gamecp->status = (struct gamecp_status *) get_zeroed_page(GFP_KERNEL);
+	if (!gamecp->status) goto err_ida;
+	gamecp->status->sources = ARRAY_NUMBER(GAMECP_INTERRUPTS);
+#ifdef GAMECP_LATENCY
+	gamecp->latency = alloc_percpu(struct gamecp_latency);
+	if (!gamecp->latency) goto err_free_page;
+#endif
 
 	rtx_spin_lock_init(&gamecp->rt_dev_lock);
+	gamecp->storm_window = max(msecs_to_jiffies(storm_window), 1UL);
+	INIT_DELAYED_WORK(&gamecp->storm_work, gamecp_storm_work);
+	INIT_DELAYED_WORK(&gamecp->busy_work, gamecp_busy_work);
+	for(i = 0; i < GAMECP_RINGS; i++) init_waitqueue_head(&gamecp->ring_wait[i]);
+	for(i = 0; i < ARRAY_NUMBER(GAMECP_INTERRUPTS); i++) INIT_LIST_HEAD(&gamecp->source[i].eventfds);
+	mutex_init(&gamecp->eventfd_lock);
+	init_waitqueue_head(&gamecp->wait_queue);
 
 	err = pci_enable_device(dev);
-	if (err) goto err_kfree2;
+	if (err) goto err_free_latency;
 
 	pci_set_master(dev);
 
-	err = pci_request_regions(dev, GAMECP_STRINGIFY(GAMECP_NAME));
+	err = pci_request_regions(dev, gamecp->name);
 	if (err) goto err_dev_disable;
 
 	gamecp->regs = pci_ioremap_bar(dev, GAMECP_INTERRUPT_CONTROLLER_BAR);
 	if (!gamecp->regs) goto err_release_regions;
+	gamecp_control_init(gamecp);
+	gamecp_layout_init(gamecp, dev);
 
 	gamecp->pci_dev = dev;
 	pci_set_drvdata(dev, gamecp);
 
-#if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,35)
-	BUG_ON(gamecp_device != NULL);
-	gamecp_device = gamecp;
-#endif
-
 	gamecp->miscdev.minor = MISC_DYNAMIC_MINOR;
-	gamecp->miscdev.name = GAMECP_STRINGIFY(GAMECP_NAME);
+	gamecp->miscdev.name = gamecp->name;
 	gamecp->miscdev.fops = &gamecp_fops;
 
 	err = misc_register(&gamecp->miscdev);
 	if (err) goto err_iounmap;
 
-	for(i = 0; i < ARRAY_NUMBER(GAMECP_INTERRUPTS); i++) {
-		gamecp_trigger(gamecp, i * gamecp->reason_num + gamecp->reason_num - 1);
-        	gamecp->clock_callback[i] = 0;
+	/* Debugging aids are optional, so failures are ignored. */
+	gamecp->debugfs = debugfs_create_dir(gamecp->name, NULL);
+	debugfs_create_file("control", S_IRUSR, gamecp->debugfs, gamecp, &gamecp_control_fops);
+	debugfs_create_file("storms", S_IRUSR, gamecp->debugfs, gamecp, &gamecp_storm_fops);
+	debugfs_create_file("unmatched", S_IRUSR, gamecp->debugfs, gamecp, &gamecp_unmatched_fops);
+#ifdef GAMECP_LATENCY
+	debugfs_create_file("latency", S_IRUSR, gamecp->debugfs, gamecp, &gamecp_latency_fops);
+#endif
+
+	for(i = 0; i < ARRAY_NUMBER(GAMECP_INTERRUPTS); i++) gamecp_set_trigger(gamecp, i * GAMECP_REASON_NUM + GAMECP_REASON_NUM - 1);
+	for(i = 0; i < ARRAY_NUMBER(gamecp->ev); i++) {
 		gamecp->ev[i].ev_id = i;
 		gamecp->ev[i].ev_disable = gamecp_event_disable;
 		gamecp->ev[i].ev_enable = 0;
 		gamecp->ev[i].endisable_par = gamecp;
 	}
-	gamecp->event_handle = rt_init_event_area(gamecp->ev, ARRAY_NUMBER(GAMECP_INTERRUPTS));
+	gamecp->event_handle = rt_init_event_area(gamecp->ev, ARRAY_NUMBER(gamecp->ev));
 	if (gamecp->event_handle < 0) {
 		err = gamecp->event_handle;
 		goto err_miscunregister;
 	}
 
-	/*
-	 * Note: MSI / edge-triggering are mandatory as we do not
-	 * silence the IRQ sources in gamecp_irq_handler. But it is
-	 * also faster.
-	 */
-	err = pci_enable_msi(gamecp->pci_dev);
+	err = gamecp_request_irqs(gamecp);
 	if (err) goto err_destroy_event;
 
-	err = rt_request_irq(gamecp->pci_dev->irq, gamecp_irq_handler, 0, GAMECP_STRINGIFY(GAMECP_NAME), gamecp, gamecp_irq_nonrt_handler);
-	if (err) goto err_disable_pci;
-
 	err = gamecp_postinit(gamecp);
 	if(err) goto err_free_irq;
 
 	return 0;
 
 err_free_irq:
-	rt_free_irq(gamecp->pci_dev->irq, gamecp);
-err_disable_pci:
-	pci_disable_msi(gamecp->pci_dev);
+	gamecp_free_irqs(gamecp);
+	cancel_delayed_work_sync(&gamecp->storm_work);
+	cancel_delayed_work_sync(&gamecp->busy_work);
 err_destroy_event:
 	rt_destroy_event_area(gamecp->event_handle);
 err_miscunregister:
+	debugfs_remove_recursive(gamecp->debugfs);
 	misc_deregister(&gamecp->miscdev);
 err_iounmap:
 	pci_iounmap(dev, gamecp->regs);
@@ -657,8 +2441,14 @@ err_release_regions:
 	pci_release_regions(dev);
 err_dev_disable:
 	pci_clear_master(dev);
-err_kfree2:
-	kfree(gamecp->src_regs);
+err_free_latency:
+#ifdef GAMECP_LATENCY
+	free_percpu(gamecp->latency);
+err_free_page:
+#endif
+	free_page((unsigned long) gamecp->status);
+err_ida:
+	ida_simple_remove(&gamecp_ida, gamecp->instance);
 err_kfree1:
 	kfree(gamecp);
 	return err;
@@ -666,18 +2456,21 @@ err_kfree1:
 static void gamecp_pci_remove(struct pci_dev *dev)
 {
 	struct gamecp_device *gamecp = pci_get_drvdata(dev);
-#if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,35)
-	gamecp_device = NULL;
-#endif
 	gamecp_preexit(gamecp);
-	rt_free_irq(gamecp->pci_dev->irq, gamecp);
-	pci_disable_msi(gamecp->pci_dev);
+	gamecp_free_irqs(gamecp);
+	cancel_delayed_work_sync(&gamecp->storm_work);
+	cancel_delayed_work_sync(&gamecp->busy_work);
 	rt_destroy_event_area(gamecp->event_handle);
+	debugfs_remove_recursive(gamecp->debugfs);
 	misc_deregister(&gamecp->miscdev);
 	pci_iounmap(dev, gamecp->regs);
 	pci_release_regions(dev);
 	pci_disable_device(dev);
-	kfree(gamecp->src_regs);
+#ifdef GAMECP_LATENCY
+	free_percpu(gamecp->latency);
+#endif
+	free_page((unsigned long) gamecp->status);
+	ida_simple_remove(&gamecp_ida, gamecp->instance);
 	kfree(gamecp);
 }
 static DEFINE_PCI_DEVICE_TABLE(gamecp_pci_ids) = {
@@ -698,6 +2491,9 @@ static int __init gamecp_init(void)
 static void __exit gamecp_exit(void)
 {
 	pci_unregister_driver(&gamecp_pci_driver);
+	ida_destroy(&gamecp_ida);
+	/* Wait for eventfd bindings still being freed. */
+	rcu_barrier();
 }
 module_init(gamecp_init);
 module_exit(gamecp_exit);
@@ -0,0 +1,110 @@
+/*
+ * Generic Audis Memory Event Clock PCI driver core (GAMECP) tracepoints
+ *
+ * Copyright (c) Siemens AG, 2026
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA  02110-1301, USA.
+ */
+
+/***************************************************************************/
+/* The tracepoints of the driver core, being included by gamecp.h. They    */
+/* show up under the device's name, e.g. events/fpga1/gamecp_dispatch, and */
+/* cost next to nothing as long as they are not enabled.                   */
+/***************************************************************************/
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM GAMECP_NAME
+
+#if !defined(__GAMECP_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define __GAMECP_TRACE_H
+
+#include <linux/tracepoint.h>
+
+/* Interrupt handler entry and exit, with the number of passes. */
+TRACE_EVENT(gamecp_irq_entry,
+	TP_PROTO(unsigned int irq),
+	TP_ARGS(irq),
+	TP_STRUCT__entry(__field(unsigned int, irq)),
+	TP_fast_assign(__entry->irq = irq;),
+	TP_printk("irq=%u", __entry->irq)
+);
+TRACE_EVENT(gamecp_irq_exit,
+	TP_PROTO(unsigned int irq, int loops),
+	TP_ARGS(irq, loops),
+	TP_STRUCT__entry(__field(unsigned int, irq) __field(int, loops)),
+	TP_fast_assign(__entry->irq = irq; __entry->loops = loops;),
+	TP_printk("irq=%u loops=%d", __entry->irq, __entry->loops)
+);
+/* The snapshot of a source register, once per pass. */
+TRACE_EVENT(gamecp_irq_snapshot,
+	TP_PROTO(int reg, unsigned long value),
+	TP_ARGS(reg, value),
+	TP_STRUCT__entry(__field(int, reg) __field(unsigned long, value)),
+	TP_fast_assign(__entry->reg = reg; __entry->value = value;),
+	TP_printk("reg=%d value=%08lx", __entry->reg, __entry->value)
+);
+/* Sources are given by their GAMECP_INTERRUPTS index. */
+DECLARE_EVENT_CLASS(gamecp_source,
+	TP_PROTO(int source, int count),
+	TP_ARGS(source, count),
+	TP_STRUCT__entry(__field(int, source) __field(int, count)),
+	TP_fast_assign(__entry->source = source; __entry->count = count;),
+	TP_printk("source=%d count=%d", __entry->source, __entry->count)
+);
+/* A source being delivered by the RT handler (count: always 1). */
+DEFINE_EVENT(gamecp_source, gamecp_dispatch, TP_PROTO(int source, int count), TP_ARGS(source, count));
+/* A source being deferred to the NonRT handler (count: pending occurrences). */
+DEFINE_EVENT(gamecp_source, gamecp_nonrt_defer, TP_PROTO(int source, int count), TP_ARGS(source, count));
+/* A deferred source being delivered (count: merged occurrences). */
+DEFINE_EVENT(gamecp_source, gamecp_nonrt_deliver, TP_PROTO(int source, int count), TP_ARGS(source, count));
+/* A pending source without clock or event (count: all such occurrences so far). */
+DEFINE_EVENT(gamecp_source, gamecp_unmatched, TP_PROTO(int source, int count), TP_ARGS(source, count));
+/* The bits of a source register being acknowledged in one pass. */
+TRACE_EVENT(gamecp_ack,
+	TP_PROTO(int reg, unsigned long bits),
+	TP_ARGS(reg, bits),
+	TP_STRUCT__entry(__field(int, reg) __field(unsigned long, bits)),
+	TP_fast_assign(__entry->reg = reg; __entry->bits = bits;),
+	TP_printk("reg=%d bits=%08lx", __entry->reg, __entry->bits)
+);
+/* Event and clock (de)registration; event is the event identifier / */
+/* reason combination, ret the result being returned to the caller.  */
+DECLARE_EVENT_CLASS(gamecp_binding,
+	TP_PROTO(int event, int ret),
+	TP_ARGS(event, ret),
+	TP_STRUCT__entry(__field(int, event) __field(int, ret)),
+	TP_fast_assign(__entry->event = event; __entry->ret = ret;),
+	TP_printk("event=%d ret=%d", __entry->event, __entry->ret)
+);
+DEFINE_EVENT(gamecp_binding, gamecp_event_bind, TP_PROTO(int event, int ret), TP_ARGS(event, ret));
+DEFINE_EVENT(gamecp_binding, gamecp_event_unbind, TP_PROTO(int event, int ret), TP_ARGS(event, ret));
+DEFINE_EVENT(gamecp_binding, gamecp_clock_register, TP_PROTO(int event, int ret), TP_ARGS(event, ret));
+DEFINE_EVENT(gamecp_binding, gamecp_clock_unregister, TP_PROTO(int event, int ret), TP_ARGS(event, ret));
+/* A mapping being set up. */
+TRACE_EVENT(gamecp_mmap,
+	TP_PROTO(unsigned long offset, unsigned long size, int ret),
+	TP_ARGS(offset, size, ret),
+	TP_STRUCT__entry(__field(unsigned long, offset) __field(unsigned long, size) __field(int, ret)),
+	TP_fast_assign(__entry->offset = offset; __entry->size = size; __entry->ret = ret;),
+	TP_printk("offset=%lx size=%lx ret=%d", __entry->offset, __entry->size, __entry->ret)
+);
+
+#endif /* __GAMECP_TRACE_H */
+
+/* Found through the -I option pointing to gamecp.h. */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE gamecp_trace
+#include <trace/define_trace.h>
@@ -41,21 +41,19 @@
 /* sizes that differ from one to the next interrupt  */
 /* control register.                                 */
 typedef unsigned int gamecp_reg_t;
+/* The interrupt control registers that the driver keeps a shadow     */
+/* copy of. None yet.                                                 */
+#define GAMECP_CONTROL_REGISTERS {}
+/* An event is identfied by its register index and its bit position,  */
+/* both sharing one integer. This is how many of the (lower) bits of   */
+/* that integer are reserved for the bit position.                     */
+#define GAMECP_SPLIT                    0
 /* We need the mapping of event identifiers to the  */
 /* combined address / bit position number defined   */
 /* in GAMECP_INTERRUPTS to create the mapping array */
 /* in gamecp.h.                                     */
 #include "ich2.h"
 
-/* An event is identfied by its register index and its bit position,  */
-/* both sharing one integer. The number returned by this function is  */
-/* how many of the (lower) bits of that integer are reserved for the  */
-/* bit position. */
-static int gamecp_split(void)
-{
-	return 0;
-}
-
 /* This function knows how to acknowledge an interrupt for a specific */
 /* event identifier / reason combination.                             */
 static void gamecp_ack(struct gamecp_device *gamecp, eventid_t event_reason)
@@ -63,22 +61,17 @@ static void gamecp_ack(struct gamecp_device *gamecp, eventid_t event_reason)
 }
 
 /* This function knows how to read a snapshot of all the device's      */
-/* interrupt source registers and returns true as long as at least one */
-/* interrupt source is active. This yields much better performance     */
-/* when testing single bits (see next function) compared to doing a    */
-/* new register read for every test.                                   */
-static bool gamecp_store(struct gamecp_device *gamecp)
+/* interrupt source registers being set in the regs bitmap into        */
+/* src_regs and returns true as long as at least one interrupt source  */
+/* is active.                                                          */
+static bool gamecp_store(struct gamecp_device *gamecp, unsigned long regs, gamecp_reg_t *src_regs)
 {
-	static bool toggle = 0;
-	toggle = !toggle;
-	return toggle;
-}
-/* This function knows how to test whether a interrupt source bit for  */
-/* a specific event identifier / reason combination is set by          */
-/* evaluating the previously stored snapshot.                          */
-static bool gamecp_test(struct gamecp_device *gamecp, eventid_t event_reason)
-{
-	return 1;
+	/* There is no source register to read yet, so we report the   */
+	/* single source as being pending on every other call, keeping */
+	/* the toggle in the handler's snapshot so that each board has */
+	/* its own.                                                    */
+	src_regs[0] = !gamecp->src_regs[0];
+	return src_regs[0];
 }
 
 /* This function knows how to set up an interrupt to fire on the       */
@@ -88,46 +81,113 @@ static void gamecp_trigger(struct gamecp_device *gamecp, eventid_t event_reason)
 {
 }
 
-/* The lower 14 bits of the DMA Address Register are not implemented, */
-/* so we need an appropriate alignment. */
-//#define ALIGNMENT_HACK
+/* The DMA buffers being handed to the FPGA. */
+static unsigned int dma_buffers = 1;
+module_param(dma_buffers, uint, S_IRUGO);
+MODULE_PARM_DESC(dma_buffers, "DMA buffers per board, 1 up to 16");
+static unsigned int dma_size = ICH2_SIZE_DMA;
+module_param(dma_size, uint, S_IRUGO);
+MODULE_PARM_DESC(dma_size, "Size of each DMA buffer in bytes, being rounded up to a power of 2 of at least 16 KB, up to 32 MB");
+struct ich2_dma {
+	unsigned int num;
+	unsigned int size;
+	struct {
+		void *cpu;
+		dma_addr_t bus;
+	} buffer[ICH2_DMA_MAX];
+};
+static void ich2_dma_free(struct gamecp_device *gamecp, struct ich2_dma *dma)
+{
+	int i;
+	for(i = 0; i < dma->num; i++) dma_free_coherent(&gamecp->pci_dev->dev, dma->size, dma->buffer[i].cpu, dma->buffer[i].bus);
+	kfree(dma);
+}
 /* This function does additional initialization at the end of          */
 /* module_init                                                         */
 static int gamecp_postinit(struct gamecp_device *gamecp)
 {
-#ifdef ALIGNMENT_HACK
-	int i, j, size = 100;
-	unsigned long pages[size];
-        // We assume that we always get susequent pages, which should be true at least after a reboot.
-        // Any ideas how to achieve proper alignment the right way are highly appreciated.
-	for(i = 0; i < size; i++) {
-		pages[i] = get_zeroed_page(GFP_KERNEL | __GFP_DMA);
-		if(!(virt_to_phys((void *) pages[i]) & 0x3fff)) break;
-	}
-	for(j = 0; j < i; j++) free_page(pages[i]);
-	if(i == size) return -ENOMEM;
-	else gamecp->user_config = (void *) pages[i];
-#else
-	gamecp->user_config = (void *) get_zeroed_page(GFP_KERNEL | __GFP_DMA);
-#endif
-	if(gamecp->user_config) {
-                *(uint32_t *) gamecp->user_config = 0x0815;
-		iowrite32(virt_to_phys(gamecp->user_config), gamecp->regs + ICH2_DMA_BASE);
-		return 0;
+	struct ich2_dma *dma;
+	int i, err;
+
+	/* Each buffer must fit into its mmap() window, which also keeps */
+	/* roundup_pow_of_two() from overflowing. */
+	if(!dma_buffers || dma_buffers > ICH2_DMA_MAX || dma_size > ICH2_DMA_WINDOW) return -EINVAL;
+	/* The DMA address register has 32 bits. */
+	err = pci_set_consistent_dma_mask(gamecp->pci_dev, DMA_BIT_MASK(32));
+	if(err) return err;
+	dma = kzalloc(sizeof(*dma), GFP_KERNEL);
+	if(!dma) return -ENOMEM;
+	/* dma_alloc_coherent() aligns a buffer to its size being      */
+	/* rounded up to a power of 2 number of pages, so a size of at */
+	/* least ICH2_DMA_ALIGN being a power of 2 yields the alignment */
+	/* that the DMA address register needs. */
+	dma->size = roundup_pow_of_two(max_t(unsigned int, dma_size, ICH2_DMA_ALIGN));
+	for(i = 0; i < dma_buffers; i++) {
+		void *cpu = dma_alloc_coherent(&gamecp->pci_dev->dev, dma->size, &dma->buffer[i].bus, GFP_KERNEL);
+		if(!cpu) {
+			err = -ENOMEM;
+			goto err_free;
+		}
+		dma->buffer[i].cpu = cpu;
+		dma->num++;
+		/* The FPGA would silently use another address otherwise. */
+		if(dma->buffer[i].bus & (ICH2_DMA_ALIGN - 1)) {
+			err = -EIO;
+			goto err_free;
+		}
+		memset(cpu, 0, dma->size);
 	}
-	else return -ENOMEM;
+	*(uint32_t *) dma->buffer[0].cpu = 0x0815;
+	iowrite32(dma->buffer[0].bus, gamecp->regs + ICH2_DMA_BASE);
+	gamecp->user_config = dma;
+	return 0;
+
+err_free:
+	ich2_dma_free(gamecp, dma);
+	return err;
 }
 /* This function does additional cleanup at the start of module_exit   */
 static void gamecp_preexit(struct gamecp_device *gamecp)
 {
 	iowrite32(0, gamecp->regs + ICH2_DMA_BASE);
-	free_page((long unsigned int) gamecp->user_config);
+	ich2_dma_free(gamecp, gamecp->user_config);
 }
-/* Any mappings beyond PCI. */
+/* Any mappings beyond PCI, i.e. the DMA buffers. */
 int gamecp_mmap_extender(struct file *filp, struct vm_area_struct *vma)
 {
 	struct gamecp_private *gamecp_priv = filp->private_data;
-	struct gamecp_device *gamecp = gamecp_priv->device;
+	struct ich2_dma *dma = gamecp_priv->device->user_config;
+	unsigned long offset = vma->vm_pgoff << PAGE_SHIFT;
 	unsigned long size = vma->vm_end - vma->vm_start;
-	return remap_pfn_range(vma, vma->vm_start, virt_to_phys(gamecp->user_config) >> PAGE_SHIFT, size, vma->vm_page_prot);
+	unsigned int index;
+
+	if(!dma || offset < ICH2_OFFSET_DMA) return -EINVAL;
+	offset -= ICH2_OFFSET_DMA;
+	index = offset / ICH2_DMA_WINDOW;
+	offset %= ICH2_DMA_WINDOW;
+	/* Do not allow mapping beyond the end of the buffer. */
+	if(index >= dma->num || offset >= dma->size || size > dma->size - offset) return -EINVAL;
+#if LINUX_VERSION_CODE < KERNEL_VERSION(3,6,0)
+	return remap_pfn_range(vma, vma->vm_start, (virt_to_phys(dma->buffer[index].cpu) + offset) >> PAGE_SHIFT, size, vma->vm_page_prot);
+#else
+	/* The buffer may come from an IOMMU or a remapped pool, so only */
+	/* the DMA API knows its pages. It takes the offset into the     */
+	/* buffer from vm_pgoff. */
+	vma->vm_pgoff = offset >> PAGE_SHIFT;
+	return dma_mmap_coherent(&gamecp_priv->device->pci_dev->dev, vma, dma->buffer[index].cpu, dma->buffer[index].bus, dma->size);
+#endif
+}
+/* Any ioctls beyond the generic ones. */
+long gamecp_ioctl_extender(struct file *filp, unsigned int cmd, unsigned long arg)
+{
+	struct gamecp_private *gamecp_priv = filp->private_data;
+	struct ich2_dma *dma = gamecp_priv->device->user_config;
+	struct ich2_dma_buffer buffer;
+
+	if(cmd != ICH2_DMA_BUFFER) return -ENOTTY;
+	if(rt_copy_from_user(&buffer, (void __user *) arg, sizeof(buffer))) return -EFAULT;
+	if(!dma || buffer.index >= dma->num) return -EINVAL;
+	buffer.size = dma->size;
+	buffer.bus = dma->buffer[buffer.index].bus;
+	return rt_copy_to_user((void __user *) arg, &buffer, sizeof(buffer)) ? -EFAULT : 0;
 }
@@ -84,8 +84,8 @@
 /* table: The lower part of the numbers being found there are the bit     */
 /* positions of the related interrupts, while the upper part serves as    */
 /* an index that allows to calculate the related register addresses. The  */
-/* exact split is defined by the value returned by the gamecp_split()     */
-/* function in fpga1.c, see there for a more detailed description.        */
+/* exact split is defined by GAMECP_SPLIT in ich2.c, see there for a     */
+/* more detailed description.                                             */
 /**************************************************************************/
 #define GAMECP_INTERRUPTS(x) x(ICH2_TDM0,               0x0)
 /**************************************************************************/
@@ -117,12 +117,21 @@
 /* easily allowing to calculate the right offset that */
 /* is to be passed to mmap() to map a specific BAR. */
 #define ICH2_OFFSET_REGISTERS           GAMECP_BAR(0)
+/* The DMA buffers are no BAR, but are mapped through the window   */
+/* behind the BARs, one ICH2_DMA_WINDOW per buffer. */
 #define ICH2_OFFSET_DMA                 GAMECP_BAR(6)
+#define ICH2_OFFSET_DMA_BUFFER(n)       (ICH2_OFFSET_DMA + (n) * ICH2_DMA_WINDOW)
 /* Sizes of each of the BARs address space. */
 #define ICH2_1KB                        1024
 #define ICH2_1MB                        (ICH2_1KB * 1024)
 #define ICH2_REGISTER_SIZE              (8 * ICH2_1KB)
-#define ICH2_SIZE_DMA                   (4 * ICH2_1KB)
+/* The default size of the DMA buffers, see the dma_size module */
+/* parameter. The lower 14 bits of the DMA address register are */
+/* not implemented, so the buffers are aligned to ICH2_DMA_ALIGN. */
+#define ICH2_SIZE_DMA                   (16 * ICH2_1KB)
+#define ICH2_DMA_ALIGN                  (16 * ICH2_1KB)
+#define ICH2_DMA_MAX                    16
+#define ICH2_DMA_WINDOW                 (GAMECP_BAR_WINDOW_SIZE / ICH2_DMA_MAX)
 /* The device's register layout. */
 #define ICH2_TEST_BASE                  0x08
 #define ICH2_TDM_BASE                   0x0c
@@ -134,4 +143,22 @@
 /* GAMECP_INTERRUPTS() event table into an enum.                          */
 /**************************************************************************/
 #include "gamecp.h"
+/**************************************************************************/
+/* The ioctls being specific to this driver.                              */
+/**************************************************************************/
+/* The driver allocates the number of DMA buffers being given by the     */
+/* dma_buffers module parameter, each of them having the same size, and  */
+/* programs the first one into the DMA address register. ICH2_DMA_BUFFER */
+/* returns the size and the bus address of the buffer with the given     */
+/* index, e.g. to program another one into the DMA address register, and */
+/* fails with EINVAL for indexes beyond the last buffer. A buffer is     */
+/* mapped by passing ICH2_OFFSET_DMA_BUFFER(index) plus an offset of up  */
+/* to its size to mmap(). */
+struct ich2_dma_buffer {
+	__u32 index;
+	__u32 size;
+	__u32 bus;
+	__u32 reserved;
+};
+#define ICH2_DMA_BUFFER _IOWR(GAMECP_IOC_MAGIC, GAMECP_IOC_EXTENDER + 0, struct ich2_dma_buffer)
 #endif /* ! __ICH2_H */
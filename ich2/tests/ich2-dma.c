@@ -22,11 +22,13 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 #include <rt/rtime.h>
 #include "ich2.h"
 
 int main(int argc, char *argv[])
 {
+	struct ich2_dma_buffer buffer;
 	struct sigevent irq_event;
 	struct timespec to;
 	siginfo_t info;
@@ -34,11 +36,18 @@ int main(int argc, char *argv[])
 	int err, fd, i;
 	uint8_t *regs, *mem;
 
-	fd = open("/dev/ich2", O_RDWR);
+	fd = open("/dev/ich2-0", O_RDWR);
 	assert(fd >= 0);
 
-	mem = mmap(NULL, ICH2_SIZE_DMA, PROT_READ | PROT_WRITE, MAP_SHARED, fd, ICH2_OFFSET_DMA);
+	/* The first DMA buffer is the one being used by the FPGA. */
+	memset(&buffer, 0, sizeof(buffer));
+	assert(ioctl(fd, ICH2_DMA_BUFFER, &buffer) == 0);
+	assert(!(buffer.bus & (ICH2_DMA_ALIGN - 1)));
+	printf("DMA buffer 0 at bus address %x, %u bytes\n", buffer.bus, buffer.size);
+	mem = mmap(NULL, buffer.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, ICH2_OFFSET_DMA_BUFFER(0));
 	assert(mem != MAP_FAILED);
+	/* Mapping beyond the end of the buffer is refused. */
+	assert(mmap(NULL, buffer.size + getpagesize(), PROT_READ, MAP_SHARED, fd, ICH2_OFFSET_DMA_BUFFER(0)) == MAP_FAILED);
         // Verication that we see the data being written by the driver during module loading:
 	printf("before: pmem=%p, mem=%x\n", mem, *(uint32_t *) mem);
         // Writing something else.
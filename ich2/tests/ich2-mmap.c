@@ -13,7 +13,7 @@
 int main(int argc, char *argv[]) {
 	uint8_t *regs;
 	int fd;
-	fd = open("/dev/ich2", O_RDWR);
+	fd = open("/dev/ich2-0", O_RDWR);
 	assert(fd >= 0);
 	regs = mmap(NULL, ICH2_REGISTER_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, ICH2_OFFSET_REGISTERS);
 	assert(regs != MAP_FAILED);
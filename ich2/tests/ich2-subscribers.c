@@ -0,0 +1,61 @@
+/*
+ * CPU555 ICH2 driver test application
+ * Several events and clocks per source
+ *
+ * Copyright (C) Siemens AG, 2026
+ * All Rights Reserved
+ */
+
+/* Registers GAMECP_SUBSCRIBERS events and clocks for TDM0, the last */
+/* clock through a second file, and checks that one more is refused.  */
+/* Closing the second file must release just its clock, so that       */
+/* exactly one more fits afterwards. As the ICH2 has only two reasons */
+/* per event identifier, a slot being mistaken for an event           */
+/* identifier / reason combination would not be released here. */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <rt/rtime.h>
+#include "ich2.h"
+
+/* Registers GAMECP_SUBSCRIBERS clocks for event, the last one through */
+/* fd2, and checks that one more is refused. */
+static void fill_clocks(int fd, int fd2, int event, struct timespec *period)
+{
+	int k;
+	for(k = 0; k < GAMECP_SUBSCRIBERS; k++)
+		assert(register_clock(k < GAMECP_SUBSCRIBERS - 1 ? fd : fd2, CLOCK_SYNC, event, period) >= 0);
+	assert(register_clock(fd, CLOCK_SYNC, event, period) < 0);
+}
+
+int main(int argc, char *argv[])
+{
+	struct timespec period = {0, 1000000};
+	struct sigevent event;
+	int fd, fd2, k;
+
+	fd = open("/dev/ich2-0", O_RDWR);
+	assert(fd >= 0);
+	fd2 = open("/dev/ich2-0", O_RDWR);
+	assert(fd2 >= 0);
+
+	memset(&event, 0, sizeof(event));
+	assert(sigevent_set_notification(&event, 0, SIGRT0, pthread_self()) == 0);
+	for(k = 0; k < GAMECP_SUBSCRIBERS; k++) assert(event_create(fd, &event, ICH2_TDM0_ENABLE) == 0);
+	assert(event_create(fd, &event, ICH2_TDM0_ENABLE) != 0);
+
+	fill_clocks(fd, fd2, ICH2_TDM0_ENABLE, &period);
+	close(fd2);
+	assert(register_clock(fd, CLOCK_SYNC, ICH2_TDM0_ENABLE, &period) >= 0);
+	assert(register_clock(fd, CLOCK_SYNC, ICH2_TDM0_ENABLE, &period) < 0);
+	printf("%d events and clocks per source\n", GAMECP_SUBSCRIBERS);
+
+	/* Closing the last file releases everything else. */
+	close(fd);
+	return 0;
+}